@@ -0,0 +1,208 @@
+#include "vector.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// vector 批量操作与逐个元素操作的对比, 以及不同规模下的 push 吞吐量
+// 用 make bench 以 -O2 构建运行
+
+#define BENCH_ELEMENTS 100000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double per_element, double bulk)
+{
+    printf("%-12s per-element %9.3f ms  bulk %9.3f ms  %6.1fx\n", name, per_element * 1e3, bulk * 1e3, per_element / bulk);
+}
+
+static struct vector *int_vector(const int *elems, int count)
+{
+    struct vector *vector = vector_create(sizeof(int));
+    vector_push_n(vector, elems, count);
+    return vector;
+}
+
+static void bench_push(const int *elems)
+{
+    double start = now();
+    struct vector *vector = vector_create(sizeof(int));
+    for (int i = 0; i < BENCH_ELEMENTS; i++)
+    {
+        vector_push(vector, (void *)&elems[i]);
+    }
+    double per_element = now() - start;
+    vector_free(vector);
+
+    start = now();
+    vector = int_vector(elems, BENCH_ELEMENTS);
+    double bulk = now() - start;
+    vector_free(vector);
+    report("push", per_element, bulk);
+}
+
+// 在开头插入 1000 个元素, 逐个插入每次都要移动整个尾部
+static void bench_splice(const int *elems)
+{
+    int total = 1000;
+    struct vector *vector = int_vector(elems, BENCH_ELEMENTS);
+    double start = now();
+    for (int i = 0; i < total; i++)
+    {
+        vector_push_at(vector, i, (void *)&elems[i]);
+    }
+    double per_element = now() - start;
+    vector_free(vector);
+
+    vector = int_vector(elems, BENCH_ELEMENTS);
+    start = now();
+    vector_splice(vector, 0, 0, elems, total);
+    double bulk = now() - start;
+    vector_free(vector);
+    report("splice", per_element, bulk);
+}
+
+static void bench_erase(const int *elems)
+{
+    int total = 1000;
+    struct vector *vector = int_vector(elems, BENCH_ELEMENTS);
+    double start = now();
+    for (int i = 0; i < total; i++)
+    {
+        vector_pop_at(vector, 0);
+    }
+    double per_element = now() - start;
+    vector_free(vector);
+
+    vector = int_vector(elems, BENCH_ELEMENTS);
+    start = now();
+    vector_erase(vector, 0, total);
+    double bulk = now() - start;
+    vector_free(vector);
+    report("erase", per_element, bulk);
+}
+
+static void bench_clear(const int *elems)
+{
+    struct vector *vector = int_vector(elems, BENCH_ELEMENTS);
+    double start = now();
+    while (!vector_empty(vector))
+    {
+        vector_pop(vector);
+    }
+    double per_element = now() - start;
+    vector_free(vector);
+
+    vector = int_vector(elems, BENCH_ELEMENTS);
+    start = now();
+    vector_clear(vector);
+    double bulk = now() - start;
+    vector_free(vector);
+    report("clear", per_element, bulk);
+}
+
+// 逐字节 fread 对比按块读入预留的容量
+static void bench_fread()
+{
+    char path[] = "/tmp/cmm_vector_bench_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *file = fdopen(fd, "w");
+    for (int i = 0; i < BENCH_ELEMENTS * 10; i++)
+    {
+        fputc('a' + i % 26, file);
+    }
+    fclose(file);
+
+    struct vector *vector = vector_create(sizeof(char));
+    file = fopen(path, "r");
+    double start = now();
+    char c;
+    while (fread(&c, 1, 1, file) == 1)
+    {
+        vector_push(vector, &c);
+    }
+    double per_element = now() - start;
+    fclose(file);
+    vector_free(vector);
+
+    vector = vector_create(sizeof(char));
+    file = fopen(path, "r");
+    start = now();
+    vector_fread(vector, 0, file);
+    double bulk = now() - start;
+    fclose(file);
+    vector_free(vector);
+    unlink(path);
+    report("fread", per_element, bulk);
+}
+
+// 旧的扩容策略: 每次满了只多分配 VECTOR_ELEMENT_INCREMENT 个元素
+static void fixed_increment_push(struct vector *vector, int total)
+{
+    for (int i = 0; i < total; i++)
+    {
+        if (vector->rindex + 1 >= vector->mindex)
+        {
+            vector_reserve(vector, vector->mindex + VECTOR_ELEMENT_INCREMENT);
+        }
+        vector_push(vector, &i);
+    }
+}
+
+// 从 10^3 到 10^7 个元素的 push 吞吐量, 单位是百万次每秒
+static void bench_push_throughput()
+{
+    printf("%-10s %12s %12s %12s\n", "elements", "fixed +20", "geometric", "reserved");
+    for (int total = 1000; total <= 10000000; total *= 10)
+    {
+        struct vector *vector = vector_create(sizeof(int));
+        double start = now();
+        fixed_increment_push(vector, total);
+        double fixed = now() - start;
+        vector_free(vector);
+
+        start = now();
+        vector = vector_create(sizeof(int));
+        for (int i = 0; i < total; i++)
+        {
+            vector_push(vector, &i);
+        }
+        double geometric = now() - start;
+        vector_free(vector);
+
+        start = now();
+        vector = vector_create(sizeof(int));
+        vector_reserve(vector, total);
+        for (int i = 0; i < total; i++)
+        {
+            vector_push(vector, &i);
+        }
+        double reserved = now() - start;
+        vector_free(vector);
+
+        printf("%-10d %12.1f %12.1f %12.1f\n", total, total / fixed / 1e6, total / geometric / 1e6, total / reserved / 1e6);
+    }
+}
+
+int main()
+{
+    int *elems = malloc(sizeof(int) * BENCH_ELEMENTS);
+    for (int i = 0; i < BENCH_ELEMENTS; i++)
+    {
+        elems[i] = i;
+    }
+
+    bench_push(elems);
+    bench_splice(elems);
+    bench_erase(elems);
+    bench_clear(elems);
+    bench_fread();
+    free(elems);
+
+    bench_push_throughput();
+    return 0;
+}
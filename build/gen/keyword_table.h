@@ -0,0 +1,44 @@
+// 由 tools/keyword_gen.c 生成, 请勿手动修改
+#define KEYWORD_HASH_SEED 190u
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 8
+
+static const struct keyword_entry keyword_table[KEYWORD_TABLE_SIZE] = {
+    [101] = {"if", 2, KEYWORD_IF},
+    [5] = {"else", 4, KEYWORD_ELSE},
+    [55] = {"while", 5, KEYWORD_WHILE},
+    [39] = {"for", 3, KEYWORD_FOR},
+    [51] = {"do", 2, KEYWORD_DO},
+    [30] = {"switch", 6, KEYWORD_SWITCH},
+    [109] = {"case", 4, KEYWORD_CASE},
+    [37] = {"default", 7, KEYWORD_DEFAULT},
+    [42] = {"break", 5, KEYWORD_BREAK},
+    [88] = {"continue", 8, KEYWORD_CONTINUE},
+    [7] = {"return", 6, KEYWORD_RETURN},
+    [6] = {"goto", 4, KEYWORD_GOTO},
+    [29] = {"typedef", 7, KEYWORD_TYPEDEF},
+    [57] = {"struct", 6, KEYWORD_STRUCT},
+    [83] = {"union", 5, KEYWORD_UNION},
+    [127] = {"enum", 4, KEYWORD_ENUM},
+    [72] = {"extern", 6, KEYWORD_EXTERN},
+    [46] = {"static", 6, KEYWORD_STATIC},
+    [114] = {"const", 5, KEYWORD_CONST},
+    [1] = {"volatile", 8, KEYWORD_VOLATILE},
+    [61] = {"register", 8, KEYWORD_REGISTER},
+    [118] = {"auto", 4, KEYWORD_AUTO},
+    [32] = {"void", 4, KEYWORD_VOID},
+    [67] = {"char", 4, KEYWORD_CHAR},
+    [25] = {"short", 5, KEYWORD_SHORT},
+    [123] = {"int", 3, KEYWORD_INT},
+    [107] = {"long", 4, KEYWORD_LONG},
+    [80] = {"float", 5, KEYWORD_FLOAT},
+    [8] = {"double", 6, KEYWORD_DOUBLE},
+    [22] = {"signed", 6, KEYWORD_SIGNED},
+    [120] = {"unsigned", 8, KEYWORD_UNSIGNED},
+    [82] = {"sizeof", 6, KEYWORD_SIZEOF},
+    [100] = {"typeof", 6, KEYWORD_TYPEOF},
+    [31] = {"bool", 4, KEYWORD_BOOL},
+    [68] = {"true", 4, KEYWORD_TRUE},
+    [34] = {"false", 5, KEYWORD_FALSE},
+    [56] = {"NULL", 4, KEYWORD_NULL},
+};
@@ -0,0 +1,111 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+// 多映射 2MB 再裁掉两端, 得到按大页对齐的块; 失败时返回 NULL
+static struct arena_chunk *arena_chunk_map(size_t size)
+{
+    size_t map_size = (sizeof(struct arena_chunk) + size + ARENA_HUGE_PAGE_SIZE - 1) & ~(size_t)(ARENA_HUGE_PAGE_SIZE - 1);
+    char *map = mmap(NULL, map_size + ARENA_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+    char *start = (char *)(((uintptr_t)map + ARENA_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE_SIZE - 1));
+    if (start > map)
+    {
+        munmap(map, start - map);
+    }
+    munmap(start + map_size, map + ARENA_HUGE_PAGE_SIZE - start);
+#ifdef MADV_HUGEPAGE
+    madvise(start, map_size, MADV_HUGEPAGE);
+#endif
+
+    struct arena_chunk *chunk = (struct arena_chunk *)start;
+    chunk->size = map_size - sizeof(struct arena_chunk);
+    chunk->mapped_size = map_size;
+    return chunk;
+}
+
+static struct arena_chunk *arena_chunk_create(struct arena *arena, size_t size)
+{
+    struct arena_chunk *chunk = arena->huge_pages ? arena_chunk_map(size) : NULL;
+    if (!chunk)
+    {
+        chunk = malloc(sizeof(struct arena_chunk) + size);
+        assert(chunk);
+        chunk->size = size;
+        chunk->mapped_size = 0;
+    }
+    chunk->next = NULL;
+    chunk->used = 0;
+    return chunk;
+}
+
+struct arena *arena_create(size_t chunk_size)
+{
+    struct arena *arena = calloc(sizeof(struct arena), 1);
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    arena->head = NULL;
+    return arena;
+}
+
+struct arena *arena_create_huge_pages(size_t chunk_size)
+{
+    struct arena *arena = arena_create(chunk_size ? chunk_size : ARENA_HUGE_PAGE_SIZE - sizeof(struct arena_chunk));
+    arena->huge_pages = true;
+    return arena;
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    struct arena_chunk *chunk = arena->head;
+    if (size > arena->chunk_size && chunk)
+    {
+        // 超大的分配单独成块挂在当前块之后, 当前块剩余的空间继续使用
+        chunk = arena_chunk_create(arena, size);
+        chunk->next = arena->head->next;
+        arena->head->next = chunk;
+        chunk->used = size;
+        return chunk->data;
+    }
+    if (!chunk || chunk->used + size > chunk->size)
+    {
+        chunk = arena_chunk_create(arena, size > arena->chunk_size ? size : arena->chunk_size);
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+
+    void *ptr = &chunk->data[chunk->used];
+    chunk->used += size;
+    return ptr;
+}
+
+void *arena_calloc(struct arena *arena, size_t size)
+{
+    void *ptr = arena_alloc(arena, size);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void arena_free(struct arena *arena)
+{
+    struct arena_chunk *chunk = arena->head;
+    while (chunk)
+    {
+        struct arena_chunk *next = chunk->next;
+        if (chunk->mapped_size)
+        {
+            munmap(chunk, chunk->mapped_size);
+        }
+        else
+        {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    free(arena);
+}
@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// 默认每块 64KB, 超过块大小的分配单独成块
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+// 使用大页时每块按 2MB 对齐并取整
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct arena_chunk
+{
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    // 以 mmap 映射的块的映射大小, malloc 分配的块为 0
+    size_t mapped_size;
+    _Alignas(ARENA_ALIGNMENT) char data[];
+};
+
+/**
+ * Bump pointer allocator. Memory is handed out from large chunks and is only
+ * ever released all at once with arena_free.
+ */
+struct arena
+{
+    struct arena_chunk *head;
+    size_t chunk_size;
+    bool huge_pages;
+};
+
+struct arena *arena_create(size_t chunk_size);
+/**
+ * Same as arena_create, but chunks are mapped on 2MB boundaries and advised
+ * to be backed by transparent huge pages. Falls back to malloc when the
+ * mapping fails.
+ */
+struct arena *arena_create_huge_pages(size_t chunk_size);
+void *arena_alloc(struct arena *arena, size_t size);
+void *arena_calloc(struct arena *arena, size_t size);
+void arena_free(struct arena *arena);
+
+#endif
@@ -2,41 +2,85 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+
+static void buffer_init(struct buffer *buffer, struct arena *arena)
+{
+    buffer->data = buffer->inline_data;
+    buffer->rindex = 0;
+    buffer->len = 0;
+    buffer->msize = BUFFER_INLINE_SIZE;
+    buffer->arena = arena;
+}
 
 struct buffer *buffer_create()
 {
-    struct buffer *buf = calloc(sizeof(struct buffer), 1);
-    buf->data = calloc(BUFFER_REALLOC_AMOUNT, 1);
-    buf->len = 0;
-    buf->msize = BUFFER_REALLOC_AMOUNT;
+    struct buffer *buf = malloc(sizeof(struct buffer));
+    buffer_init(buf, NULL);
+    return buf;
+}
+
+struct buffer *buffer_create_arena(struct arena *arena)
+{
+    struct buffer *buf = arena_alloc(arena, sizeof(struct buffer));
+    buffer_init(buf, arena);
     return buf;
 }
 
 void buffer_extend(struct buffer *buffer, size_t size)
 {
-    buffer->data = realloc(buffer->data, buffer->msize + size);
-    buffer->msize += size;
+    size_t msize = buffer->msize + size;
+    if (buffer->data != buffer->inline_data && !buffer->arena)
+    {
+        buffer->data = realloc(buffer->data, msize);
+    }
+    else
+    {
+        // 内联存储与 arena 中的旧空间不能 realloc, 复制到新分配的空间中
+        char *data = buffer->arena ? arena_alloc(buffer->arena, msize) : malloc(msize);
+        memcpy(data, buffer->data, buffer->len);
+        buffer->data = data;
+    }
+    buffer->msize = msize;
 }
 
 void buffer_need(struct buffer *buffer, size_t size)
 {
-    if (buffer->msize <= (buffer->len + size))
+    // 多留一个字节给 vsnprintf 写入的结尾 0
+    size_t needed = buffer->len + size + 1;
+    if (buffer->msize < needed)
     {
-        size += BUFFER_REALLOC_AMOUNT;
-        buffer_extend(buffer, size);
+        size_t msize = (size_t)buffer->msize * BUFFER_GROWTH_FACTOR;
+        buffer_extend(buffer, (msize > needed ? msize : needed) - buffer->msize);
     }
 }
 
+// 按实际长度格式化: 先尝试写入剩余空间, 放不下时扩容到恰好够用再写一次
+int buffer_vprintf(struct buffer *buffer, const char *fmt, va_list args)
+{
+    va_list retry;
+    va_copy(retry, args);
+    size_t avail = buffer->msize - buffer->len;
+    int actual_len = vsnprintf(&buffer->data[buffer->len], avail, fmt, args);
+    if (actual_len >= 0 && (size_t)actual_len >= avail)
+    {
+        buffer_need(buffer, actual_len);
+        vsnprintf(&buffer->data[buffer->len], actual_len + 1, fmt, retry);
+    }
+    va_end(retry);
+    if (actual_len < 0)
+    {
+        return 0;
+    }
+    buffer->len += actual_len;
+    return actual_len;
+}
+
 void buffer_printf(struct buffer *buffer, const char *fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    int index = buffer->len;
-    // Temporary, this is a limitation we are guessing the size is no more than 2048
-    int len = 2048;
-    buffer_extend(buffer, len);
-    int actual_len = vsnprintf(&buffer->data[index], len, fmt, args);
-    buffer->len += actual_len;
+    buffer_vprintf(buffer, fmt, args);
     va_end(args);
 }
 
@@ -44,12 +88,10 @@ void buffer_printf_no_terminator(struct buffer *buffer, const char *fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    int index = buffer->len;
-    // Temporary, this is a limitation we are guessing the size is no more than 2048
-    int len = 2048;
-    buffer_extend(buffer, len);
-    int actual_len = vsnprintf(&buffer->data[index], len, fmt, args);
-    buffer->len += actual_len - 1;
+    if (buffer_vprintf(buffer, fmt, args) > 0)
+    {
+        buffer->len--;
+    }
     va_end(args);
 }
 
@@ -61,6 +103,64 @@ void buffer_write(struct buffer *buffer, char c)
     buffer->len++;
 }
 
+void buffer_write_bytes(struct buffer *buffer, const void *data, size_t len)
+{
+    buffer_need(buffer, len);
+
+    memcpy(&buffer->data[buffer->len], data, len);
+    buffer->len += len;
+}
+
+void buffer_write_str(struct buffer *buffer, const char *str)
+{
+    buffer_write_bytes(buffer, str, strlen(str));
+}
+
+void buffer_write_uint(struct buffer *buffer, unsigned long long value)
+{
+    // 从低位向高位写入临时数组, 再整体复制, 不经过 vsnprintf
+    char digits[20];
+    int i = sizeof(digits);
+    do
+    {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    buffer_write_bytes(buffer, digits + i, sizeof(digits) - i);
+}
+
+void buffer_write_int(struct buffer *buffer, long long value)
+{
+    if (value < 0)
+    {
+        buffer_write(buffer, '-');
+        // 先转成无符号再取负, LLONG_MIN 也不会溢出
+        buffer_write_uint(buffer, -(unsigned long long)value);
+        return;
+    }
+    buffer_write_uint(buffer, value);
+}
+
+void buffer_write_hex(struct buffer *buffer, unsigned long long value)
+{
+    static const char hex[] = "0123456789abcdef";
+    char digits[16];
+    int i = sizeof(digits);
+    do
+    {
+        digits[--i] = hex[value & 0xf];
+        value >>= 4;
+    } while (value);
+    buffer_write_bytes(buffer, "0x", 2);
+    buffer_write_bytes(buffer, digits + i, sizeof(digits) - i);
+}
+
+void buffer_clear(struct buffer *buffer)
+{
+    buffer->len = 0;
+    buffer->rindex = 0;
+}
+
 void *buffer_ptr(struct buffer *buffer)
 {
     return buffer->data;
@@ -89,6 +189,13 @@ char buffer_peek(struct buffer *buffer)
 
 void buffer_free(struct buffer *buffer)
 {
-    free(buffer->data);
+    if (buffer->arena)
+    {
+        return;
+    }
+    if (buffer->data != buffer->inline_data)
+    {
+        free(buffer->data);
+    }
     free(buffer);
 }
@@ -3,8 +3,19 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
+#include "arena.h"
 
 #define BUFFER_REALLOC_AMOUNT 2000
+// 空间不足时容量至少翻倍, 连续写入的均摊开销为常数
+#define BUFFER_GROWTH_FACTOR 2
+// 内联存储的大小, 短小的内容不需要另外分配
+#define BUFFER_INLINE_SIZE 64
+
+/**
+ * Growable byte buffer. Contents start out in the inline storage and move to
+ * the heap, or to the owning arena, once they outgrow it.
+ */
 struct buffer
 {
     char *data;
@@ -12,17 +23,48 @@ struct buffer
     int rindex;
     int len;
     int msize;
+    // Non NULL when the buffer and its data are allocated from this arena
+    struct arena *arena;
+    char inline_data[BUFFER_INLINE_SIZE];
 };
 
 struct buffer *buffer_create();
+/**
+ * Creates a buffer that lives entirely in the given arena. buffer_free does
+ * nothing for it; the memory is released together with the arena.
+ */
+struct buffer *buffer_create_arena(struct arena *arena);
 
 char buffer_read(struct buffer *buffer);
 char buffer_peek(struct buffer *buffer);
 
 void buffer_extend(struct buffer *buffer, size_t size);
+/**
+ * Makes sure at least size more bytes (plus a terminating zero) fit without
+ * another reallocation. Grows the capacity geometrically.
+ */
+void buffer_need(struct buffer *buffer, size_t size);
+/**
+ * Formats straight into the buffer. Output of any length is written in full;
+ * the buffer is grown to the exact size when the spare capacity is too small.
+ */
 void buffer_printf(struct buffer *buffer, const char *fmt, ...);
+/**
+ * Same as buffer_printf, returns the number of characters appended.
+ */
+int buffer_vprintf(struct buffer *buffer, const char *fmt, va_list args);
 void buffer_printf_no_terminator(struct buffer *buffer, const char *fmt, ...);
 void buffer_write(struct buffer *buffer, char c);
+void buffer_write_bytes(struct buffer *buffer, const void *data, size_t len);
+void buffer_write_str(struct buffer *buffer, const char *str);
+/**
+ * Integer fast paths that write decimal or 0x-prefixed hexadecimal digits
+ * directly, without going through vsnprintf.
+ */
+void buffer_write_int(struct buffer *buffer, long long value);
+void buffer_write_uint(struct buffer *buffer, unsigned long long value);
+void buffer_write_hex(struct buffer *buffer, unsigned long long value);
+void buffer_clear(struct buffer *buffer);
 void *buffer_ptr(struct buffer *buffer);
 void buffer_free(struct buffer *buffer);
 
@@ -0,0 +1,90 @@
+#include "gap_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define GAP_BUFFER_INITIAL_CAPACITY 64
+
+struct gap_buffer *gap_buffer_create(size_t esize)
+{
+    struct gap_buffer *buffer = calloc(1, sizeof(struct gap_buffer));
+    buffer->esize = esize;
+    buffer->capacity = GAP_BUFFER_INITIAL_CAPACITY;
+    buffer->data = malloc(buffer->capacity * esize);
+    buffer->gap_start = 0;
+    buffer->gap_end = buffer->capacity;
+    return buffer;
+}
+
+void gap_buffer_free(struct gap_buffer *buffer)
+{
+    free(buffer->data);
+    free(buffer);
+}
+
+size_t gap_buffer_left_count(struct gap_buffer *buffer)
+{
+    return buffer->gap_start;
+}
+
+size_t gap_buffer_right_count(struct gap_buffer *buffer)
+{
+    return buffer->capacity - buffer->gap_end;
+}
+
+void *gap_buffer_left_data(struct gap_buffer *buffer)
+{
+    return buffer->data;
+}
+
+void *gap_buffer_right_at(struct gap_buffer *buffer, size_t index)
+{
+    if (index >= gap_buffer_right_count(buffer))
+    {
+        return NULL;
+    }
+    return buffer->data + (buffer->gap_end + index) * buffer->esize;
+}
+
+void gap_buffer_advance(struct gap_buffer *buffer)
+{
+    assert(buffer->gap_end < buffer->capacity);
+    memmove(buffer->data + buffer->gap_start * buffer->esize, buffer->data + buffer->gap_end * buffer->esize, buffer->esize);
+    buffer->gap_start++;
+    buffer->gap_end++;
+}
+
+void gap_buffer_erase(struct gap_buffer *buffer, size_t count)
+{
+    assert(count <= gap_buffer_right_count(buffer));
+    buffer->gap_end += count;
+}
+
+// 空隙不足时按倍数扩容, 右半部分移到新缓冲区的末尾
+static void gap_buffer_grow(struct gap_buffer *buffer, size_t needed)
+{
+    size_t right = gap_buffer_right_count(buffer);
+    size_t capacity = buffer->capacity * 2;
+    while (capacity - buffer->gap_start - right < needed)
+    {
+        capacity *= 2;
+    }
+
+    char *data = malloc(capacity * buffer->esize);
+    memcpy(data, buffer->data, buffer->gap_start * buffer->esize);
+    memcpy(data + (capacity - right) * buffer->esize, buffer->data + buffer->gap_end * buffer->esize, right * buffer->esize);
+    free(buffer->data);
+    buffer->data = data;
+    buffer->gap_end = capacity - right;
+    buffer->capacity = capacity;
+}
+
+void gap_buffer_insert(struct gap_buffer *buffer, const void *elements, size_t count)
+{
+    if (buffer->gap_end - buffer->gap_start < count)
+    {
+        gap_buffer_grow(buffer, count);
+    }
+    buffer->gap_end -= count;
+    memcpy(buffer->data + buffer->gap_end * buffer->esize, elements, count * buffer->esize);
+}
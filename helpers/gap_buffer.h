@@ -0,0 +1,42 @@
+#ifndef GAP_BUFFER_H
+#define GAP_BUFFER_H
+
+#include <stddef.h>
+
+/**
+ * A gap buffer of fixed size elements. Elements before the gap form the
+ * "left" part and elements after it the "right" part. Inserting at the
+ * front of the right part only copies the inserted elements, so a scanner
+ * that moves elements from right to left can splice replacements in at its
+ * cursor in time proportional to the replacement size.
+ */
+struct gap_buffer
+{
+    char *data;
+    size_t esize;
+    size_t capacity;
+
+    // [0, gap_start) is the left part, [gap_end, capacity) the right part
+    size_t gap_start;
+    size_t gap_end;
+};
+
+struct gap_buffer *gap_buffer_create(size_t esize);
+void gap_buffer_free(struct gap_buffer *buffer);
+
+size_t gap_buffer_left_count(struct gap_buffer *buffer);
+size_t gap_buffer_right_count(struct gap_buffer *buffer);
+
+// The left part is contiguous
+void *gap_buffer_left_data(struct gap_buffer *buffer);
+// The index-th element of the right part, NULL past the end
+void *gap_buffer_right_at(struct gap_buffer *buffer, size_t index);
+
+// Moves the first element of the right part to the end of the left part
+void gap_buffer_advance(struct gap_buffer *buffer);
+// Drops the first count elements of the right part
+void gap_buffer_erase(struct gap_buffer *buffer, size_t count);
+// Inserts count elements at the front of the right part
+void gap_buffer_insert(struct gap_buffer *buffer, const void *elements, size_t count);
+
+#endif
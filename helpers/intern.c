@@ -0,0 +1,132 @@
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define INTERN_INITIAL_SLOTS 1024
+
+static uint32_t intern_hash(const char *str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct intern_table *intern_table_create()
+{
+    struct intern_table *table = calloc(sizeof(struct intern_table), 1);
+    table->arena = arena_create(0);
+    table->slots = calloc(INTERN_INITIAL_SLOTS, sizeof(uint32_t));
+    table->slot_mask = INTERN_INITIAL_SLOTS - 1;
+    table->mcount = INTERN_INITIAL_SLOTS / 2;
+    table->entries = malloc(table->mcount * sizeof(struct intern_entry));
+    table->count = 0;
+    return table;
+}
+
+void intern_table_free(struct intern_table *table)
+{
+    arena_free(table->arena);
+    free(table->entries);
+    free(table->slots);
+    free(table);
+}
+
+// 保持装载因子不超过 1/2
+static void intern_table_grow(struct intern_table *table)
+{
+    uint32_t total_slots = (table->slot_mask + 1) * 2;
+    free(table->slots);
+    table->slots = calloc(total_slots, sizeof(uint32_t));
+    table->slot_mask = total_slots - 1;
+    for (int i = 0; i < table->count; i++)
+    {
+        uint32_t slot = table->entries[i].hash & table->slot_mask;
+        while (table->slots[slot])
+        {
+            slot = (slot + 1) & table->slot_mask;
+        }
+        table->slots[slot] = i + 1;
+    }
+
+    table->mcount = total_slots / 2;
+    table->entries = realloc(table->entries, table->mcount * sizeof(struct intern_entry));
+    assert(table->entries);
+}
+
+// 查找 str: 找到时返回 true 并在 result 中给出编号, 否则在 result 中给出可插入的槽位
+static bool intern_table_find(struct intern_table *table, const char *str, size_t len, uint32_t hash, uint32_t *result)
+{
+    uint32_t slot = hash & table->slot_mask;
+    while (table->slots[slot])
+    {
+        struct intern_entry *entry = &table->entries[table->slots[slot] - 1];
+        if (entry->hash == hash && entry->len == len && memcmp(entry->str, str, len) == 0)
+        {
+            *result = table->slots[slot] - 1;
+            return true;
+        }
+        slot = (slot + 1) & table->slot_mask;
+    }
+    *result = slot;
+    return false;
+}
+
+static uint32_t intern_table_insert(struct intern_table *table, const char *str, size_t len, uint32_t hash, uint32_t slot)
+{
+    uint32_t id = table->count;
+    table->entries[id] = (struct intern_entry){.str = str, .len = len, .hash = hash};
+    table->count++;
+    table->slots[slot] = table->count;
+    if (table->count >= table->mcount)
+    {
+        intern_table_grow(table);
+    }
+
+    return id;
+}
+
+uint32_t intern_string_id(struct intern_table *table, const char *str, size_t len)
+{
+    uint32_t hash = intern_hash(str, len);
+    uint32_t result = 0;
+    if (intern_table_find(table, str, len, hash, &result))
+    {
+        return result;
+    }
+
+    char *copy = arena_alloc(table->arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = 0x00;
+    return intern_table_insert(table, copy, len, hash, result);
+}
+
+uint32_t intern_string_id_static(struct intern_table *table, const char *str, size_t len, uint32_t hash)
+{
+    uint32_t result = 0;
+    if (intern_table_find(table, str, len, hash, &result))
+    {
+        return result;
+    }
+    return intern_table_insert(table, str, len, hash, result);
+}
+
+const char *intern_string(struct intern_table *table, const char *str, size_t len)
+{
+    return table->entries[intern_string_id(table, str, len)].str;
+}
+
+const char *intern_str(struct intern_table *table, uint32_t id)
+{
+    assert(id < (uint32_t)table->count);
+    return table->entries[id].str;
+}
+
+const char *intern_cstr(struct intern_table *table, const char *str)
+{
+    return intern_string(table, str, strlen(str));
+}
@@ -0,0 +1,58 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+struct intern_entry
+{
+    const char *str;
+    size_t len;
+    uint32_t hash;
+};
+
+/**
+ * String interning table. Every distinct spelling is copied once into the
+ * arena, so two interned strings are equal exactly when their pointers are.
+ */
+struct intern_table
+{
+    struct arena *arena;
+
+    // Interned strings in insertion order
+    struct intern_entry *entries;
+    int count;
+    int mcount;
+
+    // Open addressing hash slots, each holds an entry index + 1 (0 means empty)
+    uint32_t *slots;
+    uint32_t slot_mask;
+};
+
+struct intern_table *intern_table_create();
+void intern_table_free(struct intern_table *table);
+
+/**
+ * Returns the canonical copy of the first len bytes of str.
+ * The copy is always NUL terminated.
+ */
+const char *intern_string(struct intern_table *table, const char *str, size_t len);
+const char *intern_cstr(struct intern_table *table, const char *str);
+
+/**
+ * Like intern_string, but returns the entry index. Indexes are dense and
+ * stable, so they can stand in for the string in compact structures.
+ */
+uint32_t intern_string_id(struct intern_table *table, const char *str, size_t len);
+const char *intern_str(struct intern_table *table, uint32_t id);
+
+/**
+ * Adds a NUL terminated string that lives outside the arena, e.g. in a
+ * mapped cache file, without copying or rehashing it. hash must be the
+ * value recorded in an intern_entry, and str must outlive the table.
+ */
+uint32_t intern_string_id_static(struct intern_table *table, const char *str, size_t len, uint32_t hash);
+
+#endif
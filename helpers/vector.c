@@ -59,26 +59,30 @@ size_t vector_element_size(struct vector *vector)
 
 struct vector *vector_clone(struct vector *vector)
 {
-    void *new_data_address = calloc(vector->esize, vector->count + VECTOR_ELEMENT_INCREMENT);
+    // The clone keeps the same capacity so mindex stays valid
+    void *new_data_address = calloc(vector->esize, vector->mindex);
     memcpy(new_data_address, vector->data, vector_total_size(vector));
     struct vector *new_vec = calloc(sizeof(struct vector), 1);
     memcpy(new_vec, vector, sizeof(struct vector));
     new_vec->data = new_data_address;
 
     // Saves are not cloned with vector_clone yet.
-    // assert(vector->saves == NULL);
+    new_vec->saves = NULL;
     return new_vec;
 }
 
 struct vector *vector_create(size_t esize)
 {
-    struct vector *vec = vector_create_no_saves(esize);
-    vec->saves = vector_create_no_saves(sizeof(struct vector));
-    return vec;
+    // The save stack is created by the first vector_save, most vectors never need one
+    return vector_create_no_saves(esize);
 }
 
 void vector_free(struct vector *vector)
 {
+    if (vector->saves)
+    {
+        vector_free(vector->saves);
+    }
     free(vector->data);
     free(vector);
 }
@@ -88,17 +92,45 @@ int vector_current_index(struct vector *vector)
     return vector->rindex;
 }
 
+// mindex is the capacity in elements, there is always room for one more push
+static void vector_set_capacity(struct vector *vector, int capacity)
+{
+    vector->data = realloc(vector->data, (size_t)capacity * vector->esize);
+    assert(vector->data);
+    vector->mindex = capacity;
+}
+
 void vector_resize_for_index(struct vector *vector, int start_index, int total_elements)
 {
-    if (start_index + total_elements < vector->mindex)
+    int required = start_index + total_elements;
+    if (required < vector->mindex)
     {
         // Nothing to resize
         return;
     }
 
-    vector->data = realloc(vector->data, ((start_index + total_elements + VECTOR_ELEMENT_INCREMENT) * vector->esize));
-    assert(vector->data);
-    vector->mindex = start_index + total_elements;
+    // Grow geometrically so that N pushes cost O(N) copying in total
+    int capacity = vector->mindex * VECTOR_GROWTH_FACTOR;
+    if (capacity <= required)
+    {
+        capacity = required + 1;
+    }
+    vector_set_capacity(vector, capacity);
+}
+
+void vector_reserve(struct vector *vector, int total)
+{
+    if (total < vector->mindex)
+    {
+        return;
+    }
+
+    vector_set_capacity(vector, total + 1);
+}
+
+void vector_shrink_to_fit(struct vector *vector)
+{
+    vector_set_capacity(vector, vector->count + 1);
 }
 
 void vector_resize_for(struct vector *vector, int total_elements)
@@ -226,6 +258,10 @@ void vector_save(struct vector *vector)
     // We not allowed to modify the saves so set it to NULL
     // when we push it to the save stack.
     tmp_vec.saves = NULL;
+    if (!vector->saves)
+    {
+        vector->saves = vector_create_no_saves(sizeof(struct vector));
+    }
     vector_push(vector->saves, &tmp_vec);
 }
 
@@ -242,6 +278,25 @@ void vector_save_purge(struct vector *vector)
     vector_pop(vector->saves);
 }
 
+struct vector_checkpoint vector_checkpoint(struct vector *vector)
+{
+    struct vector_checkpoint checkpoint = {
+        .pindex = vector->pindex,
+        .rindex = vector->rindex,
+        .count = vector->count,
+    };
+    return checkpoint;
+}
+
+void vector_rollback(struct vector *vector, struct vector_checkpoint checkpoint)
+{
+    // Elements pushed since the checkpoint are dropped, the data and capacity stay as they are
+    assert(checkpoint.rindex <= vector->mindex);
+    vector->pindex = checkpoint.pindex;
+    vector->rindex = checkpoint.rindex;
+    vector->count = checkpoint.count;
+}
+
 void vector_pop_last_peek(struct vector *vector)
 {
     assert(vector->pindex >= 1);
@@ -264,14 +319,32 @@ void vector_push(struct vector *vector, void *elem)
 
 int vector_fread(struct vector *vector, int amount, FILE *fp)
 {
-    size_t read_amount = fread(vector->data, 1, 1, fp);
-    while (read_amount)
+    // Read whole blocks straight into the spare capacity behind the last element
+    int total = 0;
+    while (amount <= 0 || total < amount)
     {
-        vector_push(vector, &read_amount);
-        read_amount = fread(vector->data, 1, 1, fp);
+        int block = vector->mindex - vector->rindex - 1;
+        if (block < VECTOR_ELEMENT_INCREMENT)
+        {
+            vector_resize_for_index(vector, vector->rindex, VECTOR_ELEMENT_INCREMENT);
+            block = vector->mindex - vector->rindex - 1;
+        }
+        if (amount > 0 && block > amount - total)
+        {
+            block = amount - total;
+        }
+
+        size_t read_amount = fread(vector_at(vector, vector->rindex), vector->esize, block, fp);
+        vector->rindex += read_amount;
+        vector->count += read_amount;
+        total += read_amount;
+        if (read_amount < (size_t)block)
+        {
+            break;
+        }
     }
 
-    return 0;
+    return total;
 }
 
 const char *vector_string(struct vector *vec)
@@ -297,10 +370,12 @@ int vector_elements_until_end(struct vector *vector, int index)
 
 void vector_shift_right_in_bounds_no_increment(struct vector *vector, int index, int amount)
 {
-    vector_resize_for_index(vector, index, amount);
+    // Everything from index up to the end moves right by amount
+    vector_resize_for_index(vector, vector->rindex, amount);
     int eindex = (index + amount);
     size_t bytes_to_move = vector_elements_until_end(vector, index) * vector->esize;
-    memcpy(vector_at(vector, eindex), vector_at(vector, index), bytes_to_move);
+    // The ranges overlap whenever amount is smaller than the moved tail
+    memmove(vector_at(vector, eindex), vector_at(vector, index), bytes_to_move);
     memset(vector_at(vector, index), 0x00, amount * vector->esize);
 }
 
@@ -367,13 +442,56 @@ void vector_shift_right(struct vector *vector, int index, int amount)
 
 void vector_pop_at(struct vector *vector, int index)
 {
-    char *dst_pos = (char *)vector_at(vector, index);
-    char *next_element_pos = dst_pos + vector->esize;
-    char *end_pos = (char *)vector_data_end(vector);
-    size_t total = (size_t)end_pos - (size_t)next_element_pos;
-    memcpy(dst_pos, next_element_pos, total);
-    vector->count -= 1;
-    vector->rindex -= 1;
+    vector_erase(vector, index, 1);
+}
+
+void vector_splice(struct vector *vector, int index, int remove_count, const void *elems, int insert_count)
+{
+    assert(index >= 0 && remove_count >= 0 && insert_count >= 0);
+    assert(index + remove_count <= vector->rindex);
+    if (insert_count > remove_count)
+    {
+        vector_resize_for_index(vector, vector->rindex, insert_count - remove_count);
+    }
+
+    // Shift the tail once, then copy the new elements into the gap
+    int tail = vector->rindex - index - remove_count;
+    memmove(vector_at(vector, index + insert_count), vector_at(vector, index + remove_count), (size_t)tail * vector->esize);
+    if (insert_count)
+    {
+        memcpy(vector_at(vector, index), elems, (size_t)insert_count * vector->esize);
+    }
+    vector->rindex += insert_count - remove_count;
+    vector->count += insert_count - remove_count;
+}
+
+void vector_erase(struct vector *vector, int index, int total)
+{
+    vector_splice(vector, index, total, NULL, 0);
+}
+
+void vector_swap_remove(struct vector *vector, int index)
+{
+    assert(vector_in_bounds_for_at(vector, index));
+    int last = vector->rindex - 1;
+    if (index != last)
+    {
+        memcpy(vector_at(vector, index), vector_at(vector, last), vector->esize);
+    }
+    vector->rindex--;
+    vector->count--;
+}
+
+void vector_push_n(struct vector *vector, const void *elems, int total)
+{
+    if (total <= 0)
+    {
+        return;
+    }
+    vector_resize_for_index(vector, vector->rindex, total);
+    memcpy(vector_at(vector, vector->rindex), elems, (size_t)total * vector->esize);
+    vector->rindex += total;
+    vector->count += total;
 }
 
 void vector_peek_pop(struct vector *vector)
@@ -386,6 +504,13 @@ void vector_peek_pop(struct vector *vector)
 
 void vector_push_multiple_at(struct vector *vector, int dst_index, void *ptr, int total)
 {
+    if (dst_index <= vector->rindex)
+    {
+        vector_splice(vector, dst_index, 0, ptr, total);
+        return;
+    }
+
+    // Past the end, the gap before dst_index is zero filled
     vector_shift_right(vector, dst_index, total);
     void *dst_ptr = vector_at(vector, dst_index);
     size_t total_bytes = total * vector->esize;
@@ -435,10 +560,9 @@ bool vector_empty(struct vector *vector)
 
 void vector_clear(struct vector *vector)
 {
-    while (vector_count(vector))
-    {
-        vector_pop(vector);
-    }
+    // The capacity is kept for the next pushes
+    vector->rindex = 0;
+    vector->count = 0;
 }
 
 void *vector_back_or_null(struct vector *vector)
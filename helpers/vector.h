@@ -6,10 +6,12 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <assert.h>
 
-// We want at least 20 vector element spaces in reserve before having
-// to reallocate memory again
+// Initial capacity of a new vector in elements
 #define VECTOR_ELEMENT_INCREMENT 20
+// Once full the capacity is multiplied by this factor
+#define VECTOR_GROWTH_FACTOR 2
 
 enum
 {
@@ -33,9 +35,18 @@ struct vector
     // Data is not restored and is permenant, save does not respect data, only pointers
     // and variables are saved. Useful to temporarily push the vector state
     // and restore it later.
+    // NULL until the first vector_save.
     struct vector *saves;
 };
 
+// Snapshot of the vector indexes taken by vector_checkpoint, kept by value
+struct vector_checkpoint
+{
+    int pindex;
+    int rindex;
+    int count;
+};
+
 typedef struct vector vector;
 
 struct vector *vector_create(size_t esize);
@@ -59,9 +70,24 @@ void vector_pop_last_peek(struct vector *vector);
  * Use this function instead of vector_peek if this is a vector of pointers
  */
 void *vector_peek_ptr(struct vector *vector);
+/**
+ * Makes sure total elements fit without reallocating, use it when the final size
+ * is known or can be estimated up front
+ */
+void vector_reserve(struct vector *vector, int total);
+
+/**
+ * Releases the unused capacity, for vectors that will not grow any more
+ */
+void vector_shrink_to_fit(struct vector *vector);
 void vector_set_peek_pointer(struct vector *vector, int index);
 void vector_set_peek_pointer_end(struct vector *vector);
 void vector_push(struct vector *vector, void *elem);
+
+/**
+ * Pushes total elements stored contiguously at elems with a single copy
+ */
+void vector_push_n(struct vector *vector, const void *elems, int total);
 void vector_push_at(struct vector *vector, int index, void *ptr);
 void vector_pop(struct vector *vector);
 void vector_peek_pop(struct vector *vector);
@@ -85,7 +111,8 @@ void vector_clear(struct vector *vector);
 
 int vector_count(struct vector *vector);
 /**
- * freads from the file directly into the vector
+ * freads up to amount elements (until EOF when amount <= 0) from the file,
+ * appending them to the vector in blocks. Returns the number of elements read
  */
 int vector_fread(struct vector *vector, int amount, FILE *fp);
 /**
@@ -110,6 +137,23 @@ int vector_pop_value(struct vector *vector, void *val);
 
 void vector_pop_at(struct vector *vector, int index);
 
+/**
+ * Replaces remove_count elements starting at index with insert_count elements
+ * from elems, moving the tail only once
+ */
+void vector_splice(struct vector *vector, int index, int remove_count, const void *elems, int insert_count);
+
+/**
+ * Removes total elements starting at index, keeping the order of the rest
+ */
+void vector_erase(struct vector *vector, int index, int total);
+
+/**
+ * Removes the element at index by moving the last element into its place.
+ * O(1) but does not keep the order
+ */
+void vector_swap_remove(struct vector *vector, int index);
+
 /**
  * Decrements the peek pointer so that the next peek
  * will point at the last peeked token
@@ -135,6 +179,18 @@ void vector_restore(struct vector *vector);
  */
 void vector_save_purge(struct vector *vector);
 
+/**
+ * Returns a snapshot of the peek pointer and the element count. Unlike vector_save
+ * nothing is allocated, so taking one per backtracking attempt is cheap
+ */
+struct vector_checkpoint vector_checkpoint(struct vector *vector);
+
+/**
+ * Goes back to the checkpoint: the peek pointer is restored and elements pushed
+ * since are dropped. Elements that were overwritten in place are not restored
+ */
+void vector_rollback(struct vector *vector, struct vector_checkpoint checkpoint);
+
 /**
  * Returns the element size per element in this vector
  */
@@ -145,4 +201,94 @@ size_t vector_element_size(struct vector *vector);
  */
 struct vector *vector_clone(struct vector *vector);
 
+/**
+ * Makes room for total_elements starting at start_index, growing the capacity if needed
+ */
+void vector_resize_for_index(struct vector *vector, int start_index, int total_elements);
+
+/**
+ * Vectors whose element type is known at compile time.
+ *
+ * VECTOR_DEFINE_TYPED(name, type) defines VEC(name), a distinct wrapper around a
+ * struct vector of sizeof(type) elements, and static inline vec_<name>_* accessors
+ * that index with sizeof(type) and copy elements by assignment, instead of
+ * multiplying by the runtime esize and calling memcpy, so hot loops over them can
+ * be inlined. Passing a VEC(token) where a VEC(node_ptr) is expected does not
+ * compile. The untyped vector_* functions take &vec->base.
+ */
+#define VEC(name) struct vec_##name
+
+#define VECTOR_DEFINE_TYPED(name, type)                                                \
+    VEC(name)                                                                          \
+    {                                                                                  \
+        struct vector base;                                                            \
+    };                                                                                 \
+                                                                                       \
+    static inline VEC(name) *vec_##name##_create()                                     \
+    {                                                                                  \
+        return (VEC(name) *)vector_create(sizeof(type));                               \
+    }                                                                                  \
+                                                                                       \
+    static inline int vec_##name##_count(VEC(name) *vec)                               \
+    {                                                                                  \
+        return vec->base.count;                                                        \
+    }                                                                                  \
+                                                                                       \
+    static inline type *vec_##name##_data(VEC(name) *vec)                              \
+    {                                                                                  \
+        return (type *)vec->base.data;                                                 \
+    }                                                                                  \
+                                                                                       \
+    static inline type *vec_##name##_at(VEC(name) *vec, int index)                     \
+    {                                                                                  \
+        return (type *)vec->base.data + index;                                         \
+    }                                                                                  \
+                                                                                       \
+    static inline void vec_##name##_push(VEC(name) *vec, type elem)                    \
+    {                                                                                  \
+        struct vector *vector = &vec->base;                                            \
+        if (vector->rindex + 1 >= vector->mindex)                                      \
+        {                                                                              \
+            vector_resize_for_index(vector, vector->rindex, 1);                        \
+        }                                                                              \
+        ((type *)vector->data)[vector->rindex] = elem;                                 \
+        vector->rindex++;                                                              \
+        vector->count++;                                                               \
+    }                                                                                  \
+                                                                                       \
+    static inline type *vec_##name##_back_or_null(VEC(name) *vec)                      \
+    {                                                                                  \
+        struct vector *vector = &vec->base;                                            \
+        return vector->rindex > 0 ? (type *)vector->data + vector->rindex - 1 : NULL;  \
+    }                                                                                  \
+                                                                                       \
+    static inline type *vec_##name##_back(VEC(name) *vec)                              \
+    {                                                                                  \
+        assert(vec->base.rindex > 0);                                                  \
+        return (type *)vec->base.data + vec->base.rindex - 1;                          \
+    }                                                                                  \
+                                                                                       \
+    static inline type *vec_##name##_peek_no_increment(VEC(name) *vec)                 \
+    {                                                                                  \
+        struct vector *vector = &vec->base;                                            \
+        if (vector->pindex < 0 || vector->pindex >= vector->rindex)                    \
+        {                                                                              \
+            return NULL;                                                               \
+        }                                                                              \
+        return (type *)vector->data + vector->pindex;                                  \
+    }                                                                                  \
+                                                                                       \
+    static inline type *vec_##name##_peek(VEC(name) *vec)                              \
+    {                                                                                  \
+        type *elem = vec_##name##_peek_no_increment(vec);                              \
+        if (elem)                                                                      \
+        {                                                                              \
+            vec->base.pindex += vec->base.flags & VECTOR_FLAG_PEEK_DECREMENT ? -1 : 1; \
+        }                                                                              \
+        return elem;                                                                   \
+    }
+
+// Vector of untyped pointers, such as scope entities
+VECTOR_DEFINE_TYPED(ptr, void *)
+
 #endif
\ No newline at end of file
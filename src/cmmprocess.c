@@ -1,14 +1,110 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <malloc.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "compiler.h"
 #include "../helpers/vector.h"
 
-compile_process *compile_process_create(const char *filename, const char *output_filename, int output_type)
+// 将输入文件映射到内存, 非普通文件 (管道等) 返回 false
+static bool compile_process_map_input(cfile *input)
+{
+    struct stat st;
+    int fd = fileno(input->file);
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+
+    input->data = NULL;
+    if (st.st_size > 0)
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        input->data = data;
+    }
+
+    input->end = input->data + st.st_size;
+    input->cur = input->data;
+    input->mapped = true;
+    return true;
+}
+
+// 无法映射时把整个输入读入堆内存, 词法分析器总是面对一段连续的内存
+static void compile_process_read_input(cfile *input)
+{
+    size_t size = 0;
+    size_t msize = BUFFER_REALLOC_AMOUNT;
+    char *data = malloc(msize);
+    size_t read_amount = 0;
+    while ((read_amount = fread(data + size, 1, msize - size, input->file)) > 0)
+    {
+        size += read_amount;
+        if (size == msize)
+        {
+            msize *= 2;
+            data = realloc(data, msize);
+        }
+    }
+
+    input->data = data;
+    input->end = data + size;
+    input->cur = data;
+    input->mapped = false;
+}
+
+// 打开源文件并把内容整体放入内存, 文件不存在时返回 NULL
+cfile *cfile_open(const char *filename)
 {
     FILE *file = fopen(filename, "r");
     if (file == NULL)
+    {
+        return NULL;
+    }
+
+    cfile *input = (cfile *)malloc(sizeof(cfile));
+    input->file = file;
+    input->abs_path = filename;
+    input->line_starts = NULL;
+    input->owns_data = true;
+    if (!compile_process_map_input(input))
+    {
+        compile_process_read_input(input);
+    }
+    return input;
+}
+
+static void cfile_close(cfile *file)
+{
+    if (file->owns_data && file->mapped)
+    {
+        munmap((void *)file->data, file->end - file->data);
+    }
+    else if (file->owns_data)
+    {
+        free((void *)file->data);
+    }
+    if (file->file)
+    {
+        fclose(file->file);
+    }
+    if (file->line_starts)
+    {
+        vector_free(file->line_starts);
+    }
+    free(file);
+}
+
+compile_process *compile_process_create(const char *filename, const char *output_filename, int output_type, int flags)
+{
+    cfile *input = cfile_open(filename);
+    if (input == NULL)
     {
         printf("File %s not found.\n", filename);
         return NULL;
@@ -21,44 +117,138 @@ compile_process *compile_process_create(const char *filename, const char *output
         if (output_file == NULL)
         {
             printf("File %s cannot be opened.\n", output_filename);
+            cfile_close(input);
             return NULL;
         }
     }
 
-    compile_process *process = (compile_process *)malloc(sizeof(compile_process));
-    process->node_vec = vector_create(sizeof(struct node *));
-    process->node_tree_vec = vector_create(sizeof(struct node *));
-    process->input_file = (cfile *)malloc(sizeof(cfile));
-    process->input_file->file = file;
+    compile_process *process = (compile_process *)calloc(1, sizeof(compile_process));
+    process->node_vec = vec_node_ptr_create();
+    process->node_tree_vec = vec_node_ptr_create();
+    process->input_file = input;
+    process->files = vector_create(sizeof(cfile *));
+    compile_process_add_file(process, input);
+    process->flags = flags;
+    process->offset = 0;
+    process->file_id = 0;
+    process->token_vec = NULL;
+    process->token_stream = NULL;
     process->ofile = output_file;
+    process->output = buffer_create();
     process->output_type = output_type;
+    process->strings = intern_table_create();
+    process->literals = vector_create(sizeof(struct token_literal));
+    process->macros = macro_table_create();
+    process->included_once = vector_create(sizeof(char *));
+    process->arena = flags & COMPILE_PROCESS_FLAG_HUGE_PAGES ? arena_create_huge_pages(0) : arena_create(0);
     return process;
 }
 
+// 释放编译进程拥有的一切, 词法分析器要先于它释放
+void compile_process_free(compile_process *process)
+{
+    for (int i = 0; i < vector_count(process->files); i++)
+    {
+        cfile_close(compile_process_file(process, i));
+    }
+    vector_free(process->files);
+    if (process->pch_map)
+    {
+        munmap((void *)process->pch_map, process->pch_map_size);
+    }
+    if (process->token_cache_map)
+    {
+        munmap((void *)process->token_cache_map, process->token_cache_map_size);
+    }
+
+    if (process->token_vec)
+    {
+        vector_free(&process->token_vec->base);
+    }
+    if (process->token_stream)
+    {
+        token_stream_free(process->token_stream);
+    }
+    vector_free(&process->node_vec->base);
+    vector_free(&process->node_tree_vec->base);
+    // 第一个压栈的是最外层之前的空表
+    if (process->symbols.tables)
+    {
+        for (int i = 0; i < vector_count(process->symbols.tables); i++)
+        {
+            struct vector *table = *(struct vector **)vector_at(process->symbols.tables, i);
+            if (table)
+            {
+                vector_free(table);
+            }
+        }
+        vector_free(process->symbols.tables);
+    }
+    if (process->symbols.table)
+    {
+        vector_free(process->symbols.table);
+    }
+
+    if (process->ofile)
+    {
+        fclose(process->ofile);
+    }
+    buffer_free(process->output);
+    intern_table_free(process->strings);
+    vector_free(process->literals);
+    macro_table_free(process->macros);
+    vector_free(process->included_once);
+    arena_free(process->arena);
+    free(process);
+}
+
+// 登记一个源文件, 返回它的编号, 即其中 token 的 file_id
+uint16_t compile_process_add_file(compile_process *process, cfile *file)
+{
+    assert(vector_count(process->files) <= UINT16_MAX);
+    vector_push(process->files, &file);
+    return vector_count(process->files) - 1;
+}
+
+cfile *compile_process_file(compile_process *process, uint16_t file_id)
+{
+    return *(cfile **)vector_at(process->files, file_id);
+}
+
 char compile_process_next_char(lex_process *process)
 {
-    compile_process *compiler = process->compiler;
-    compiler->pos.col++;
-    char c = getc(compiler->input_file->file);
-    if (c == '\n')
+    cfile *input = process->compiler->input_file;
+    if (input->cur >= input->end)
     {
-        compiler->pos.col = 1;
-        compiler->pos.line++;
+        return EOF;
     }
-    return c;
+    return *input->cur++;
 }
 
 char compile_process_peek_char(lex_process *process)
 {
-    compile_process *compiler = process->compiler;
-    char c = getc(compiler->input_file->file);
-    ungetc(c, compiler->input_file->file);
-    return c;
+    cfile *input = process->compiler->input_file;
+    return input->cur < input->end ? *input->cur : EOF;
 }
 
 void compile_process_push_char(lex_process *process, char c)
 {
-    compile_process *compiler = process->compiler;
-    ungetc(c, compiler->input_file->file);
-    compiler->pos.col--;
-}
\ No newline at end of file
+    cfile *input = process->compiler->input_file;
+    // 只能退回刚刚读出的字符
+    assert(input->cur > input->data && input->cur[-1] == c);
+    input->cur--;
+}
+
+const char *compile_process_peek_span(lex_process *process, size_t *len)
+{
+    cfile *input = process->compiler->input_file;
+    *len = input->end - input->cur;
+    return input->cur;
+}
+
+void compile_process_skip(lex_process *process, size_t len)
+{
+    cfile *input = process->compiler->input_file;
+    assert(len <= (size_t)(input->end - input->cur));
+    input->cur += len;
+}
@@ -1,10 +1,13 @@
 #include "compiler.h"
 #include <stdarg.h>
+#include "../helpers/vector.h"
 
 lex_process_functions compiler_lex_functions = {
     .next_char = compile_process_next_char,
     .peek_char = compile_process_peek_char,
     .push_char = compile_process_push_char,
+    .peek_span = compile_process_peek_span,
+    .skip = compile_process_skip,
 };
 
 void compiler_error(compile_process *compiler, const char *msg, ...)
@@ -14,7 +17,8 @@ void compiler_error(compile_process *compiler, const char *msg, ...)
     vfprintf(stderr, msg, args);
     va_end(args);
 
-    fprintf(stderr, "%s:%d:%d: error: ", compiler->input_file->abs_path, compiler->pos.line, compiler->pos.col);
+    pos position = source_position(compile_process_file(compiler, compiler->file_id), compiler->offset);
+    fprintf(stderr, "%s:%d:%d: error: ", position.filename, position.line, position.col);
     exit(-1);
 }
 
@@ -25,33 +29,97 @@ void compiler_warning(compile_process *compiler, const char *msg, ...)
     vfprintf(stderr, msg, args);
     va_end(args);
 
-    fprintf(stderr, "%s:%d:%d: warning: ", compiler->input_file->abs_path, compiler->pos.line, compiler->pos.col);
+    pos position = source_position(compile_process_file(compiler, compiler->file_id), compiler->offset);
+    fprintf(stderr, "%s:%d:%d: warning: ", position.filename, position.line, position.col);
+}
+
+// 释放编译用到的一切, 返回 res; 还没有并入 process->token_vec 的 token 向量也在这里释放
+static int compile_file_finish(compile_process *process, lex_process *lexer, VEC(token) *prelude_tokens, int res)
+{
+    if (prelude_tokens && prelude_tokens != process->token_vec)
+        vector_free(&prelude_tokens->base);
+    if (lexer && lexer->token_vec == process->token_vec)
+        process->token_vec = NULL;
+    if (lexer)
+        lex_process_free(lexer);
+    compile_process_free(process);
+    return res;
 }
 
 // 编译器主入口
-int compile_file(const char *filename, const char *output_filename, int output_type)
+int compile_file(const char *filename, const char *output_filename, int output_type, int flags)
 {
-    compile_process *process = compile_process_create(filename, output_filename, output_type);
+    compile_process *process = compile_process_create(filename, output_filename, output_type, flags);
     if (!process)
         return FAILURE;
 
     // lexical analysis
 
     lex_process *lex_process_instance = lex_process_create(process, &compiler_lex_functions, NULL);
+    VEC(token) *prelude_tokens = NULL;
 
     if (!lex_process_instance)
-        return FAILURE;
-    if (lex(lex_process_instance) != LEXICAL_ANALYSIS_ALL_OK)
-        return FAILURE;
+        return compile_file_finish(process, NULL, NULL, FAILURE);
+    if (process->flags & COMPILE_PROCESS_FLAG_STREAM_TOKENS)
+    {
+        if (process->flags & (COMPILE_PROCESS_FLAG_PARALLEL_LEX | COMPILE_PROCESS_FLAG_TOKEN_CACHE | COMPILE_PROCESS_FLAG_PRELUDE))
+        {
+            printf("Streaming tokens cannot be combined with parallel lexing, the token cache or a prelude.\n");
+            return compile_file_finish(process, lex_process_instance, NULL, FAILURE);
+        }
+        // 语法分析时再按需读取 token, 不经过预处理
+        process->token_stream = token_stream_create(lex_process_instance);
+    }
+    else
+    {
+        // 前置头文件的内容位于输入文件之前, 必须先于输入文件处理
+        const char *prelude = getenv("CMM_PRELUDE");
+        if (process->flags & COMPILE_PROCESS_FLAG_PRELUDE && prelude && *prelude)
+        {
+            prelude_tokens = pch_load(process, prelude);
+            if (!prelude_tokens)
+            {
+                printf("Prelude %s not found.\n", prelude);
+                return compile_file_finish(process, lex_process_instance, NULL, FAILURE);
+            }
+        }
+
+        // 驻留表中已有前置头文件的字符串时, 编号与 token 缓存对不上
+        bool use_cache = process->flags & COMPILE_PROCESS_FLAG_TOKEN_CACHE && !prelude_tokens;
+        uint64_t hash = use_cache ? token_cache_hash(process->input_file->data, process->input_file->end - process->input_file->data) : 0;
+        if (use_cache && token_cache_load(process, lex_process_instance, hash))
+        {
+            print_token_vec(process, lex_process_instance->token_vec);
+        }
+        else
+        {
+            int res = process->flags & COMPILE_PROCESS_FLAG_PARALLEL_LEX ? lex_parallel(lex_process_instance) : lex(lex_process_instance);
+            if (res != LEXICAL_ANALYSIS_ALL_OK)
+                return compile_file_finish(process, lex_process_instance, prelude_tokens, FAILURE);
+
+            if (use_cache)
+                token_cache_store(process, lex_process_instance->token_vec, hash);
+        }
+
+        process->token_vec = lex_process_instance->token_vec;
+        if (preprocess(process) != PREPROCESS_ALL_OK)
+            return compile_file_finish(process, lex_process_instance, prelude_tokens, FAILURE);
 
-    process->token_vec = lex_process_instance->token_vec;
+        if (prelude_tokens)
+        {
+            vector_push_n(&prelude_tokens->base, vec_token_data(process->token_vec), vec_token_count(process->token_vec));
+            vector_free(&process->token_vec->base);
+            process->token_vec = prelude_tokens;
+        }
+    }
 
     // parsing
 
     // if (parse(process) != PARSE_ALL_OK)
     // {
-    //     return FAILURE;
+    //     return compile_file_finish(process, lex_process_instance, prelude_tokens, FAILURE);
     // }
 
-    return SUCCESS;
+    emit_flush(process);
+    return compile_file_finish(process, lex_process_instance, prelude_tokens, SUCCESS);
 }
\ No newline at end of file
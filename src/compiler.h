@@ -4,8 +4,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <setjmp.h>
 #include <string.h>
 #include "../helpers/buffer.h"
+#include "../helpers/intern.h"
+#include "../helpers/vector.h"
 
 #define S_EQ(str1, str2) \
     (str1 && str2 && strcmp(str1, str2) == 0)
@@ -24,6 +28,12 @@ enum
     LEXICAL_ANALYSIS_ERROR
 };
 
+enum
+{
+    PREPROCESS_ALL_OK,
+    PREPROCESS_ERROR
+};
+
 enum output_type
 {
     OUTPUT_TYPE_ASSEMBLY,
@@ -31,47 +41,38 @@ enum output_type
     OUTPUT_TYPE_EXECUTABLE
 };
 
-#define NUMERIC_CASES \
-    case '0':         \
-    case '1':         \
-    case '2':         \
-    case '3':         \
-    case '4':         \
-    case '5':         \
-    case '6':         \
-    case '7':         \
-    case '8':         \
-    case '9'
-
-// 操作符
-#define OPERATOR_CASES_EXCLUDING_DIVISION \
-    case '+':                             \
-    case '-':                             \
-    case '*':                             \
-    case '>':                             \
-    case '<':                             \
-    case '^':                             \
-    case '%':                             \
-    case '!':                             \
-    case '=':                             \
-    case '~':                             \
-    case '|':                             \
-    case '&':                             \
-    case '(':                             \
-    case '[':                             \
-    case ',':                             \
-    case '.':                             \
-    case '?'
-
-#define SYMBOL_CASE \
-    case '{':       \
-    case '}':       \
-    case ':':       \
-    case ';':       \
-    case '#':       \
-    case '\\':      \
-    case ')':       \
-    case ']'
+// 汇编输出中使用的寄存器, 名称见 emitter.c
+enum
+{
+    REGISTER_EAX,
+    REGISTER_EBX,
+    REGISTER_ECX,
+    REGISTER_EDX,
+    REGISTER_ESI,
+    REGISTER_EDI,
+    REGISTER_ESP,
+    REGISTER_EBP,
+    REGISTER_COUNT
+};
+
+// 输出缓冲超过该大小时写入 ofile
+#define EMIT_FLUSH_THRESHOLD (64 * 1024)
+
+// compile_process 选项
+enum
+{
+    // 不预先生成完整的 token 向量, 语法分析器按需从词法分析器拉取 token.
+    // 只有词法分析: 不做预处理, 遇到预处理指令时报错; 不能与下面三个选项同时使用
+    COMPILE_PROCESS_FLAG_STREAM_TOKENS = 0b00000001,
+    // 大文件按行切块, 在多个线程上并行进行词法分析
+    COMPILE_PROCESS_FLAG_PARALLEL_LEX = 0b00000010,
+    // 按源码内容的哈希在缓存目录中查找词法分析结果, 未命中时分析后写入缓存
+    COMPILE_PROCESS_FLAG_TOKEN_CACHE = 0b00000100,
+    // 先处理环境变量 CMM_PRELUDE 指定的前置头文件, 其预编译映像保存在缓存目录中
+    COMPILE_PROCESS_FLAG_PRELUDE = 0b00001000,
+    // 编译进程的 arena 按 2MB 分块, 并建议内核用大页支撑
+    COMPILE_PROCESS_FLAG_HUGE_PAGES = 0b00010000
+};
 
 // token types
 enum
@@ -86,14 +87,55 @@ enum
     TOKEN_TYPE_SYMBOL,
 };
 
+// keywords, 列表见 keywords.def
+enum
+{
+    KEYWORD_NONE,
+#define KEYWORD(name, str) KEYWORD_##name,
+#include "keywords.def"
+#undef KEYWORD
+    KEYWORD_TOTAL
+};
+
+// operators, 列表见 operators.def
+enum
+{
+    OP_NONE,
+#define OPERATOR(name, str) OP_##name,
+#define OPERATOR_NODE(name, str)
+#include "operators.def"
+#undef OPERATOR
+#undef OPERATOR_NODE
+    // 以上是词法分析器可以读出的操作符
+    OP_LEXABLE_TOTAL,
+    OP_LEXABLE_END = OP_LEXABLE_TOTAL - 1,
+#define OPERATOR(name, str)
+#define OPERATOR_NODE(name, str) OP_##name,
+#include "operators.def"
+#undef OPERATOR
+#undef OPERATOR_NODE
+    OP_TOTAL
+};
+
 enum
 {
     NUMBER_TYPE_NORMAL,
     NUMBER_TYPE_LONG,
+    NUMBER_TYPE_LONG_LONG,
     NUMBER_TYPE_FLOAT,
     NUMBER_TYPE_DOUBLE
 };
 
+enum
+{
+    // token 位于括号表达式内部
+    TOKEN_FLAG_IN_EXPRESSION = 0b00000001,
+    // token 后面跟着空白字符
+    TOKEN_FLAG_WHITESPACE = 0b00000010,
+    // 出现在同名宏的展开结果中, 预处理器不再展开它
+    TOKEN_FLAG_NO_EXPAND = 0b00000100
+};
+
 typedef struct pos
 {
     int line;
@@ -101,34 +143,55 @@ typedef struct pos
     const char *filename;
 } pos;
 
-typedef struct token
+// 数字字面量, 存放在 compile_process 的字面量池中
+struct token_literal
 {
     int type;
-    int flags;
-    pos pos;
-
+    // 带有 U 后缀
+    bool is_unsigned;
     union
     {
-        char cval;
-        const char *sval;
-        unsigned int inum;
-        unsigned long lnum;
         unsigned long long llnum;
-        void *any;
+        // NUMBER_TYPE_FLOAT 与 NUMBER_TYPE_DOUBLE
+        double dval;
     };
+};
 
-    struct token_number
-    {
-        int type;
-    } num;
+/**
+ * @brief 紧凑的 16 字节 token, 一条缓存行可放下 4 个。
+ *
+ * 字符串与数字不直接存放在 token 中: payload 是驻留表或字面量池中的编号,
+ * 通过 token_sval / token_literal 取出; 行列号由 offset 经 token_position 计算。
+ */
+typedef struct token
+{
+    uint8_t type;
+    uint8_t flags;
+    // 所在文件编号, 0 为主输入文件
+    uint16_t file_id;
 
-    /**
-     * @brief 表示是否包含空白字符的布尔值。
-     */
-    bool whitespace;
+    // token 在源码中的位置: 起始偏移与长度, 括号内的源码按需由此计算
+    uint32_t offset;
+    uint32_t length;
 
-    const char *between_brackets;
+    union
+    {
+        // TOKEN_TYPE_IDENTIFIER, STRING, COMMENT 在驻留表中的编号
+        uint32_t str_id;
+        // TOKEN_TYPE_NUMBER 在字面量池中的编号
+        uint32_t literal_id;
+        // TOKEN_TYPE_KEYWORD 的关键字编号
+        int keyword;
+        // TOKEN_TYPE_OPERATOR 的操作符编号
+        int op;
+        // TOKEN_TYPE_SYMBOL 的字符
+        char cval;
+        uint32_t payload;
+    };
 } token;
+_Static_assert(sizeof(struct token) == 16, "token 应保持 16 字节");
+// token 向量的定长访问函数 vec_token_*
+VECTOR_DEFINE_TYPED(token, struct token)
 
 /**
  * @brief Represents the compile process information.
@@ -139,20 +202,39 @@ typedef struct token
  */
 typedef struct compile_process compile_process;
 bool token_is_primitive_keyword(struct token *token);
-bool token_is_operator(struct token *token, const char *op);
+bool token_is_keyword_id(struct token *token, int keyword);
+int token_keyword(struct token *token);
+bool token_is_operator(struct token *token, int op);
+const char *token_between_brackets(compile_process *process, struct token *token);
+const char *token_sval(compile_process *process, struct token *token);
+struct token_literal *token_literal(compile_process *process, struct token *token);
+pos token_position(compile_process *process, struct token *token);
 
 typedef struct compile_process_input_file
 {
     FILE *file;
     const char *abs_path;
+
+    // 输入文件位于内存中 (mmap 映射或整体读入), 词法分析器直接移动 cur 指针读取字符
+    bool mapped;
+    // data 归这个文件所有, 关闭时 munmap 或 free; 前置头文件映像中的文件为 false
+    bool owns_data;
+    const char *data;
+    const char *end;
+    const char *cur;
+
+    // 每行起始偏移, 首次计算行列号时建立
+    struct vector *line_starts;
 } cfile;
 
+pos source_position(cfile *file, size_t offset);
+
 // scope
 struct scope
 {
     int flags;
 
-    struct vector *entities;
+    VEC(ptr) *entities;
 
     size_t size;
 
@@ -173,23 +255,57 @@ struct symbol
     void *data;
 };
 
+// 预处理器的宏定义
+struct macro
+{
+    // 宏名的驻留编号
+    uint32_t name;
+    // #undef 之后保留在表中, 重新定义时复用
+    bool defined;
+    bool function_like;
+    // 最后一个参数是 ..., 对应 __VA_ARGS__
+    bool variadic;
+    // 参数名的驻留编号
+    int param_count;
+    uint32_t *params;
+    // 替换列表
+    VEC(token) *body;
+    // 正在展开的层数, 大于 0 时宏名不再展开, 防止递归
+    int active;
+};
+
+// 以宏名的驻留编号为键的开放寻址哈希表
+struct macro_table
+{
+    struct macro **slots;
+    uint32_t mask;
+    int count;
+};
+
 struct compile_process
 {
+    int flags; ///< COMPILE_PROCESS_FLAG_*
 
     cfile *input_file; ///< The input file.
     FILE *ofile;       ///< The output file.
+    struct buffer *output; ///< 待写入 ofile 的输出, 由 emit_* 函数追加
     int output_type;   ///< The type of output for the compiler.
 
-    pos pos; ///< The current position of the compiler.
+    size_t offset;    ///< 当前处理到的源码偏移, 报错时才换算成行列号
+    uint16_t file_id; ///< offset 所在的文件, 词法分析器也用它标记新 token
+
+    // 输入文件与被包含的头文件 (cfile *), 下标即 token 的 file_id, 0 为 input_file
+    struct vector *files;
 
     /**
      * @brief 编译器结构体
      *
      * 该结构体包含了编译器所需的向量数据结构。
      */
-    struct vector *token_vec;     /**< 词法分析结果向量 */
-    struct vector *node_vec;      /**< 语法分析结果向量 */
-    struct vector *node_tree_vec; /**< 语法树向量 */
+    VEC(token) *token_vec;        /**< 词法分析结果向量 */
+    struct token_stream *token_stream; /**< 流式模式下代替 token_vec */
+    VEC(node_ptr) *node_vec;      /**< 语法分析结果向量 */
+    VEC(node_ptr) *node_tree_vec; /**< 语法树向量 */
 
     struct
     {
@@ -202,20 +318,58 @@ struct compile_process
         struct vector *tables;
         struct vector *table;
     } symbols;
+
+    // 标识符, 关键字, 操作符等字符串的驻留表, token 与 node 的 sval 都指向这里
+    struct intern_table *strings;
+    // 数字字面量池, 元素为 struct token_literal
+    struct vector *literals;
+
+    // 预处理器定义的宏, 在前置头文件与输入文件之间共享
+    struct macro_table *macros;
+    // 带有 #pragma once 或 include guard 且已经包含过的头文件的真实路径 (char *)
+    struct vector *included_once;
+
+    // 前置头文件映像的映射, 其中的文件内容与字符串在整个编译期间都要用到
+    const void *pch_map;
+    size_t pch_map_size;
+    // token 缓存文件的映射, 命中缓存时驻留表中的字符串指向这里
+    const void *token_cache_map;
+    size_t token_cache_map_size;
+
+    // 语法树节点, 作用域, 符号与数据类型等编译期间的对象从这里分配, 编译结束时一起释放; 不能跨线程共用
+    struct arena *arena;
 };
 
 // 词法分析器结构体定义
 
 typedef struct lex_process_functions lex_process_functions;
 typedef struct lex_process lex_process;
+
+enum
+{
+    // 从文件中间的某一行开始分析, 不检查括号是否匹配
+    LEX_PROCESS_FLAG_CHUNK = 0b00000001
+};
+
 struct lex_process
 {
-    pos pos;
-    struct vector *token_vec;
+    int flags; ///< LEX_PROCESS_FLAG_*
+    VEC(token) *token_vec;
     compile_process *compiler;
 
     int current_expression_count;
-    struct buffer *parentheses_buffer;
+    // 源码起始地址, token 的 offset 相对于这里
+    const char *source;
+    // source 在输入文件中的偏移, 报告词法错误时使用
+    size_t base;
+    // 读取单个 token 时复用的临时缓冲区, 结果会被驻留
+    struct buffer *scratch_buffer;
+    // 最近一个读出的 token 存放的位置, 读到空白时在它上面设置 TOKEN_FLAG_WHITESPACE
+    struct token *last_token;
+    // 只读出起始偏移小于 limit 的 token
+    size_t limit;
+    // 非空时词法错误跳转到这里而不是退出
+    jmp_buf *recover;
     lex_process_functions *function;
 
     void *private;
@@ -286,14 +440,15 @@ struct datatype
         size_t size;
     } array;
 };
-bool keyword_is_datatype(const char *str);
+bool keyword_is_datatype(int keyword);
 
 struct node
 {
     int type;
     int flags;
 
-    struct pos pos;
+    // 节点在源码中的偏移
+    uint32_t offset;
 
     struct node_binded
     {
@@ -307,7 +462,7 @@ struct node
         {
             struct node *left;
             struct node *right;
-            const char *op;
+            int op;
         } exp;
 
         struct var
@@ -324,7 +479,7 @@ struct node
 
         struct body
         {
-            struct vector *statements;
+            VEC(node_ptr) *statements;
             size_t size;
             /**
              * @brief 表示是否进行了填充的布尔值。
@@ -341,8 +496,11 @@ struct node
         unsigned int inum;
         unsigned long lnum;
         unsigned long long llnum;
+        double dval;
     };
 };
+// 节点指针向量的定长访问函数 vec_node_ptr_*
+VECTOR_DEFINE_TYPED(node_ptr, struct node *)
 
 enum
 {
@@ -392,30 +550,100 @@ enum
 typedef char (*LEX_PROCESS_NEXT_CHAR)(lex_process *process);
 typedef char (*LEX_PROCESS_PEEK_CHAR)(lex_process *process);
 typedef void (*LEX_PROCESS_PUSH_CHAR)(lex_process *process, char c);
+// 返回尚未读取的连续输入及其长度, 供批量扫描使用
+typedef const char *(*LEX_PROCESS_PEEK_SPAN)(lex_process *process, size_t *len);
+// 一次读过 len 个字节
+typedef void (*LEX_PROCESS_SKIP)(lex_process *process, size_t len);
 
 struct lex_process_functions
 {
     LEX_PROCESS_NEXT_CHAR next_char;
     LEX_PROCESS_PEEK_CHAR peek_char;
     LEX_PROCESS_PUSH_CHAR push_char;
+    LEX_PROCESS_PEEK_SPAN peek_span;
+    LEX_PROCESS_SKIP skip;
 };
 
-int compile_file(const char *filename, const char *output_filename, int output_type);
-compile_process *compile_process_create(const char *filename, const char *output_filename, int output_type);
+int compile_file(const char *filename, const char *output_filename, int output_type, int flags);
+int lex_parallel(lex_process *process);
+int lex_incremental(lex_process *process, size_t start, size_t end, const char *text, size_t len);
+uint64_t token_cache_hash(const char *data, size_t len);
+bool token_cache_load(compile_process *process, lex_process *lexer, uint64_t hash);
+void token_cache_store(compile_process *process, VEC(token) *token_vec, uint64_t hash);
+const char *token_cache_dir();
+VEC(token) *pch_load(compile_process *process, const char *prelude);
+compile_process *compile_process_create(const char *filename, const char *output_filename, int output_type, int flags);
+void compile_process_free(compile_process *process);
+cfile *cfile_open(const char *filename);
+uint16_t compile_process_add_file(compile_process *process, cfile *file);
+cfile *compile_process_file(compile_process *process, uint16_t file_id);
+int preprocess(compile_process *process);
+VEC(token) *preprocess_prelude(compile_process *process, const char *path);
+struct macro_table *macro_table_create();
+void macro_table_free(struct macro_table *table);
+struct macro *macro_table_get(struct macro_table *table, uint32_t name);
+struct macro *macro_table_entry(struct macro_table *table, uint32_t name);
+
+extern lex_process_functions compiler_lex_functions;
 
 // lex_process_functions
 char compile_process_next_char(lex_process *process);
 char compile_process_peek_char(lex_process *process);
 void compile_process_push_char(lex_process *process, char c);
+const char *compile_process_peek_span(lex_process *process, size_t *len);
+void compile_process_skip(lex_process *process, size_t len);
 
 // lex_process
 lex_process *lex_process_create(compile_process *compiler, lex_process_functions *functions, void *data);
 void lex_process_free(lex_process *process);
 void *lex_process_private(lex_process *process);
-struct vector *lex_process_tokens(lex_process *process);
+VEC(token) *lex_process_tokens(lex_process *process);
 
 // lexer
 int lex(lex_process *process);
+void print_token_vec(compile_process *compiler, VEC(token) *token_vec);
+void lex_begin(lex_process *process);
+struct token *lex_next_token(lex_process *process);
+
+// 流式读取 token 时保留的窗口大小, 须为 2 的幂
+#define TOKEN_STREAM_WINDOW 64
+
+/**
+ * 语法分析器与词法分析器之间的 token 环形缓冲区。
+ * 只有最近读出的 TOKEN_STREAM_WINDOW 个 token 保持有效,
+ * 需要跨越任意多 token 保留的 token 应当复制一份。
+ */
+struct token_stream
+{
+    lex_process *lexer;
+    struct token window[TOKEN_STREAM_WINDOW];
+    // 下一个交给语法分析器的 token 的序号
+    size_t head;
+    // 已经读出的 token 总数
+    size_t tail;
+    bool eof;
+    // 下一个读出的 token 位于行首
+    bool line_start;
+};
+
+struct token_stream *token_stream_create(lex_process *lexer);
+void token_stream_free(struct token_stream *stream);
+struct token *token_stream_peek(struct token_stream *stream);
+struct token *token_stream_next(struct token_stream *stream);
+
+// lexer scanning, 在 SSE2/AVX2 可用时每次比较 16/32 个字节
+size_t lex_scan_until_char(const char *str, size_t len, char c);
+size_t lex_scan_until_either(const char *str, size_t len, char a, char b);
+size_t lex_scan_comment_end(const char *str, size_t len);
+size_t lex_scan_identifier(const char *str, size_t len);
+void lex_scan_line_starts(const char *str, size_t len, struct vector *line_starts);
+
+// lex_number.c
+size_t lex_number_parse(const char *str, size_t len, struct token_literal *literal, const char **error);
+
+// keyword
+int keyword_lookup(const char *str, size_t len);
+const char *keyword_str(int keyword);
 
 // error and warning
 void compiler_error(compile_process *compiler, const char *msg, ...);
@@ -428,7 +656,8 @@ int parse(compile_process *compiler);
 
 // node
 
-void node_set_vector(struct vector *vec, struct vector *root_vec);
+void node_set_vector(VEC(node_ptr) *vec, VEC(node_ptr) *root_vec);
+void node_set_arena(struct arena *arena);
 void node_push(struct node *node);
 struct node *node_peek_or_null();
 struct node *node_peek();
@@ -436,8 +665,8 @@ struct node *node_pop();
 struct node *node_create(struct node *node);
 bool node_is_expressionable(struct node *node);
 struct node *node_peek_expressionable_or_null();
-void make_exp_node(struct node *left_node, struct node *right_node, const char *op);
-void make_body_node(struct vector *body_vec, size_t size, bool padded, struct node *largest_var_node);
+void make_exp_node(struct node *left_node, struct node *right_node, int op);
+void make_body_node(VEC(node_ptr) *body_vec, size_t size, bool padded, struct node *largest_var_node);
 
 // history
 enum
@@ -449,9 +678,6 @@ enum
 };
 
 // expression
-#define TOTAL_OPERATOR_GROUPS 14
-#define MAX_OPERATORS_IN_GROUP 12
-
 enum
 {
     ASSOCIATIVITY_LEFT_TO_RIGHT,
@@ -459,9 +685,14 @@ enum
 };
 struct expressionable_op_precedence_group
 {
-    char *operators[MAX_OPERATORS_IN_GROUP];
+    // 数值越小优先级越高
+    int precedence;
     int associativity;
 };
+extern const struct expressionable_op_precedence_group op_precedence[OP_TOTAL];
+
+// operator
+const char *operator_str(int op);
 
 // datatype
 bool datatype_is_struct_or_union_for_name(const char *name);
@@ -470,7 +701,7 @@ size_t datatype_size_no_ptr(struct datatype *dtype);
 size_t datatype_size(struct datatype *dtype);
 
 // scope functions
-struct scope *scope_alloc();
+struct scope *scope_alloc(struct compile_process *process);
 struct scope *scope_create_root(struct compile_process *process);
 void scope_free_root(struct compile_process *process);
 struct scope *scope_new(struct compile_process *process, int flags);
@@ -484,6 +715,15 @@ void scope_push(struct compile_process *process, void *ptr, size_t elem_size);
 void scope_finish(struct compile_process *process);
 struct scope *scope_current(struct compile_process *process);
 
+// emitter, 输出先写入 compile_process->output, 累积到一定大小再写入文件
+void emit(compile_process *process, const char *fmt, ...);
+void emit_str(compile_process *process, const char *str);
+void emit_int(compile_process *process, long long value);
+void emit_register(compile_process *process, int reg);
+void emit_label_name(compile_process *process, const char *prefix, int id);
+void emit_label(compile_process *process, const char *prefix, int id);
+void emit_flush(compile_process *process);
+
 // helper
 size_t variable_size(struct node *var_node);
 size_t variable_size_for_list(struct node *var_list_node);
@@ -0,0 +1,83 @@
+#include "compiler.h"
+#include <assert.h>
+#include <stdarg.h>
+
+// 按寄存器编号排列, 长度已知, 输出时直接复制
+static const struct
+{
+    const char *name;
+    size_t len;
+} emit_registers[REGISTER_COUNT] = {
+    [REGISTER_EAX] = {"eax", 3},
+    [REGISTER_EBX] = {"ebx", 3},
+    [REGISTER_ECX] = {"ecx", 3},
+    [REGISTER_EDX] = {"edx", 3},
+    [REGISTER_ESI] = {"esi", 3},
+    [REGISTER_EDI] = {"edi", 3},
+    [REGISTER_ESP] = {"esp", 3},
+    [REGISTER_EBP] = {"ebp", 3},
+};
+
+// 积累的输出超过阈值时写入文件, 没有输出文件时全部留在缓冲中
+static void emit_maybe_flush(compile_process *process)
+{
+    if (process->ofile && process->output->len >= EMIT_FLUSH_THRESHOLD)
+    {
+        emit_flush(process);
+    }
+}
+
+void emit(compile_process *process, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    buffer_vprintf(process->output, fmt, args);
+    va_end(args);
+    emit_maybe_flush(process);
+}
+
+void emit_str(compile_process *process, const char *str)
+{
+    buffer_write_str(process->output, str);
+    emit_maybe_flush(process);
+}
+
+void emit_int(compile_process *process, long long value)
+{
+    buffer_write_int(process->output, value);
+    emit_maybe_flush(process);
+}
+
+void emit_register(compile_process *process, int reg)
+{
+    assert(reg >= 0 && reg < REGISTER_COUNT);
+    buffer_write_bytes(process->output, emit_registers[reg].name, emit_registers[reg].len);
+    emit_maybe_flush(process);
+}
+
+// 标签名为前缀加编号, 例如 .L12
+void emit_label_name(compile_process *process, const char *prefix, int id)
+{
+    buffer_write_str(process->output, prefix);
+    buffer_write_int(process->output, id);
+    emit_maybe_flush(process);
+}
+
+// 定义标签, 单独占一行
+void emit_label(compile_process *process, const char *prefix, int id)
+{
+    emit_label_name(process, prefix, id);
+    buffer_write_bytes(process->output, ":\n", 2);
+    emit_maybe_flush(process);
+}
+
+// 把缓冲中的输出全部写入 ofile
+void emit_flush(compile_process *process)
+{
+    if (!process->ofile)
+    {
+        return;
+    }
+    fwrite(buffer_ptr(process->output), 1, process->output->len, process->ofile);
+    buffer_clear(process->output);
+}
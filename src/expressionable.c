@@ -2,21 +2,49 @@
 #include "../helpers/vector.h"
 #include <assert.h>
 
-struct expressionable_op_precedence_group op_precedence[TOTAL_OPERATOR_GROUPS] = {
-    {.operators = {"++", "--", "()", "[]", "(", "[", "]", ".", "->", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"*", "/", "%", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"+", "-", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"<<", ">>", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"<", "<=", ">", ">=", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"==", "!=", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"&", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"^", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"|", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"&&", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"||", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
-    {.operators = {"?", ":", NULL}, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
-    {.operators = {"=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|=", NULL}, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
-    {.operators = {",", NULL}, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+// 按操作符编号直接索引; 未列出的操作符 (一元操作符等) 按最高优先级处理
+const struct expressionable_op_precedence_group op_precedence[OP_TOTAL] = {
+    [OP_INCREMENT] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_DECREMENT] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_CALL] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_SUBSCRIPT] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_LPAREN] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_LBRACKET] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_RBRACKET] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_DOT] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_ARROW] = {.precedence = 0, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_MUL] = {.precedence = 1, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_DIV] = {.precedence = 1, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_MOD] = {.precedence = 1, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_ADD] = {.precedence = 2, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_SUB] = {.precedence = 2, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_SHL] = {.precedence = 3, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_SHR] = {.precedence = 3, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_LT] = {.precedence = 4, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_LE] = {.precedence = 4, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_GT] = {.precedence = 4, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_GE] = {.precedence = 4, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_EQ] = {.precedence = 5, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_NE] = {.precedence = 5, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_BITWISE_AND] = {.precedence = 6, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_BITWISE_XOR] = {.precedence = 7, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_BITWISE_OR] = {.precedence = 8, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_LOGICAL_AND] = {.precedence = 9, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_LOGICAL_OR] = {.precedence = 10, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
+    [OP_QUESTION] = {.precedence = 11, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_COLON] = {.precedence = 11, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_ADD_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_SUB_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_MUL_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_DIV_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_MOD_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_SHL_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_SHR_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_AND_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_XOR_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_OR_ASSIGN] = {.precedence = 12, .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT},
+    [OP_COMMA] = {.precedence = 13, .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT},
 };
 
 // void expressionable_parse(struct expressionable *expressionable);
@@ -0,0 +1,37 @@
+#include "compiler.h"
+#include "keyword_hash.h"
+#include "keyword_table.h"
+
+static const char *keyword_names[KEYWORD_TOTAL] = {
+    [KEYWORD_NONE] = NULL,
+#define KEYWORD(name, str) [KEYWORD_##name] = str,
+#include "keywords.def"
+#undef KEYWORD
+};
+
+// 一次哈希探测加一次比较, 不是关键字返回 KEYWORD_NONE
+int keyword_lookup(const char *str, size_t len)
+{
+    if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN)
+    {
+        return KEYWORD_NONE;
+    }
+
+    const struct keyword_entry *entry = &keyword_table[keyword_hash(str, len, KEYWORD_HASH_SEED) & (KEYWORD_TABLE_SIZE - 1)];
+    if (entry->name && entry->len == len && memcmp(entry->name, str, len) == 0)
+    {
+        return entry->keyword;
+    }
+
+    return KEYWORD_NONE;
+}
+
+const char *keyword_str(int keyword)
+{
+    if (keyword <= KEYWORD_NONE || keyword >= KEYWORD_TOTAL)
+    {
+        return NULL;
+    }
+
+    return keyword_names[keyword];
+}
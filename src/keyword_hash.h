@@ -0,0 +1,32 @@
+#ifndef KEYWORD_HASH_H
+#define KEYWORD_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 关键字完美哈希表的大小, 必须是 2 的幂
+#define KEYWORD_TABLE_SIZE 128
+
+struct keyword_entry
+{
+    const char *name;
+    size_t len;
+    int keyword;
+};
+
+/**
+ * 带种子的 FNV-1a 哈希. tools/keyword_gen.c 在构建时搜索一个使所有关键字
+ * 互不冲突的种子, 词法分析器使用同一个函数查表, 只需一次探测.
+ */
+static inline uint32_t keyword_hash(const char *str, size_t len, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "compiler.h"
+#include "token.h"
+#include "../helpers/vector.h"
+#include <assert.h>
+#include <sys/mman.h>
+
+// 在 token 之前的括号深度上计入这个 token, 返回 token 是否在括号内
+static bool lex_incremental_apply_depth(struct token *token, int *depth)
+{
+    if (token_is_symbol(token, ')'))
+    {
+        (*depth)--;
+    }
+    bool in_expression = *depth > 0;
+    if (token_is_operator(token, OP_LPAREN))
+    {
+        (*depth)++;
+    }
+    return in_expression;
+}
+
+// 计算 tokens[index] 之前的括号深度: 向前找到一个不在括号内的 token, 它之前的深度一定是 0
+static int lex_incremental_depth_before(struct token *tokens, int index)
+{
+    int anchor = index;
+    while (anchor > 0)
+    {
+        anchor--;
+        if (!(tokens[anchor].flags & TOKEN_FLAG_IN_EXPRESSION) && !token_is_symbol(&tokens[anchor], ')'))
+        {
+            break;
+        }
+    }
+
+    int depth = 0;
+    for (int i = anchor; i < index; i++)
+    {
+        lex_incremental_apply_depth(&tokens[i], &depth);
+    }
+    return depth;
+}
+
+/**
+ * 编辑后增量地重新进行词法分析: 把源码中的 [start, end) 替换为 text.
+ *
+ * 从编辑位置之前最后一个不受影响的 token 之后开始分析, 直到分析出的 token 与编辑位置之后的某个旧 token
+ * 完全相同. 词法分析器在 token 之间的状态只有上一个 token (#include 之后的 '<' 按字符串读取),
+ * 因此分析前先放入编辑位置之前的 token, 同步之后的 token 都不会变化, 只需要平移偏移.
+ * 出现词法错误时返回 LEXICAL_ANALYSIS_ERROR, 源码与 token 保持不变.
+ */
+int lex_incremental(lex_process *process, size_t start, size_t end, const char *text, size_t len)
+{
+    cfile *input = process->compiler->input_file;
+    size_t size = input->end - input->data;
+    assert(start <= end && end <= size);
+
+    // 生成编辑后的源码
+    size_t new_size = size - (end - start) + len;
+    char *data = malloc(new_size + 1);
+    memcpy(data, input->data, start);
+    memcpy(data + start, text, len);
+    memcpy(data + start + len, input->data + end, size - end);
+    long delta = (long)len - (long)(end - start);
+
+    // 第一个结尾不在编辑位置之前的 token 可能受影响, 从它前一个 token 的结尾开始重新分析
+    struct token *tokens = vec_token_data(process->token_vec);
+    int count = vec_token_count(process->token_vec);
+    int first = 0;
+    while (first < count && tokens[first].offset + tokens[first].length < start)
+    {
+        first++;
+    }
+    size_t restart = first > 0 ? tokens[first - 1].offset + tokens[first - 1].length : 0;
+
+    cfile old_input = *input;
+    input->data = data;
+    input->end = data + new_size;
+    input->cur = data + restart;
+
+    lex_process *lexer = lex_process_create(process->compiler, process->function, NULL);
+    lexer->flags |= LEX_PROCESS_FLAG_CHUNK;
+    jmp_buf recover;
+    lexer->recover = &recover;
+    if (setjmp(recover))
+    {
+        lex_process_free(lexer);
+        free(data);
+        *input = old_input;
+        return LEXICAL_ANALYSIS_ERROR;
+    }
+    lex_begin(lexer);
+    // 放入副本, 分析器对它的修改 (后面是否有空白) 在替换完成后统一重新计算
+    struct token previous = first > 0 ? tokens[first - 1] : (struct token){0};
+    lexer->last_token = first > 0 ? &previous : NULL;
+
+    // 编辑位置之后第一个可以重新同步的旧 token
+    int resync = first;
+    struct token *token = NULL;
+    while ((token = lex_next_token(lexer)))
+    {
+        token->offset += restart;
+        while (resync < count && (tokens[resync].offset < end || tokens[resync].offset + delta < token->offset))
+        {
+            resync++;
+        }
+        if (resync < count && tokens[resync].offset + delta == token->offset &&
+            tokens[resync].type == token->type && tokens[resync].length == token->length)
+        {
+            break;
+        }
+        vec_token_push(lexer->token_vec, *token);
+        lexer->last_token = vec_token_back(lexer->token_vec);
+    }
+    if (!token)
+    {
+        // 一直分析到文件尾也没有同步, 替换掉全部剩余的旧 token
+        resync = count;
+    }
+
+    // 计算新 token 的括号深度; 与旧 token 在同步点的深度不同时, 后面所有 token 都要重新计算
+    int depth = lex_incremental_depth_before(tokens, first);
+    int old_depth = depth;
+    for (int i = first; i < resync; i++)
+    {
+        lex_incremental_apply_depth(&tokens[i], &old_depth);
+    }
+    VEC(token) *replacement = lexer->token_vec;
+    for (int i = 0; i < vec_token_count(replacement); i++)
+    {
+        struct token *new_token = vec_token_at(replacement, i);
+        new_token->flags &= ~TOKEN_FLAG_IN_EXPRESSION;
+        if (lex_incremental_apply_depth(new_token, &depth))
+        {
+            new_token->flags |= TOKEN_FLAG_IN_EXPRESSION;
+        }
+        if (depth < 0)
+        {
+            longjmp(recover, 1);
+        }
+    }
+
+    bool rebalance = depth != old_depth;
+    if (rebalance)
+    {
+        // 括号不再匹配的编辑不生效
+        int tail_depth = depth;
+        for (int i = resync; i < count; i++)
+        {
+            lex_incremental_apply_depth(&tokens[i], &tail_depth);
+            if (tail_depth < 0)
+            {
+                longjmp(recover, 1);
+            }
+        }
+    }
+
+    int added = vec_token_count(replacement);
+    // 用新的 token 替换 [first, resync) 的 token
+    vector_splice(&process->token_vec->base, first, resync - first, vec_token_data(replacement), added);
+    lex_process_free(lexer);
+    tokens = vec_token_data(process->token_vec);
+    count = vec_token_count(process->token_vec);
+
+    int tail = first + added;
+    for (int i = tail; i < count; i++)
+    {
+        tokens[i].offset += delta;
+        if (rebalance)
+        {
+            tokens[i].flags &= ~TOKEN_FLAG_IN_EXPRESSION;
+            if (lex_incremental_apply_depth(&tokens[i], &depth))
+            {
+                tokens[i].flags |= TOKEN_FLAG_IN_EXPRESSION;
+            }
+        }
+    }
+
+    // 替换范围两端的 token 之后是否跟着空白
+    for (int i = first > 0 ? first - 1 : 0; i < tail && i < count; i++)
+    {
+        size_t next_offset = i + 1 < count ? tokens[i + 1].offset : new_size;
+        tokens[i].flags &= ~TOKEN_FLAG_WHITESPACE;
+        if (next_offset > tokens[i].offset + tokens[i].length)
+        {
+            tokens[i].flags |= TOKEN_FLAG_WHITESPACE;
+        }
+    }
+
+    if (old_input.mapped)
+    {
+        munmap((void *)old_input.data, size);
+    }
+    else
+    {
+        free((void *)old_input.data);
+    }
+    input->mapped = false;
+    input->cur = input->end;
+    if (input->line_starts)
+    {
+        vector_free(input->line_starts);
+        input->line_starts = NULL;
+    }
+    return LEXICAL_ANALYSIS_ALL_OK;
+}
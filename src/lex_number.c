@@ -0,0 +1,540 @@
+#include "compiler.h"
+#include "pow5_table.h"
+#include <math.h>
+
+/**
+ * 数字字面量解析, 直接读取源码, 不分配内存.
+ * 十进制数字用 SWAR 一次转换 8 个字节; 浮点数用 Eisel-Lemire 算法正确舍入,
+ * 少数无法确定舍入方向的情况交给 strtod.
+ */
+
+// 8 个字节是否全是十进制数字
+static bool lex_number_is_eight_digits(uint64_t chunk)
+{
+    return (((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+// 把 8 个十进制数字转换为整数, 每一步把相邻的两组合并
+static uint32_t lex_number_parse_eight_digits(uint64_t chunk)
+{
+    chunk = (chunk & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    chunk = (chunk & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return (uint32_t)((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+}
+
+static int lex_number_digit_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return 16;
+}
+
+static size_t lex_number_parse_decimal(const char *str, size_t len, unsigned long long *value, bool *overflow)
+{
+    unsigned long long result = 0;
+    size_t i = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (i + 8 <= len)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, str + i, sizeof(chunk));
+        if (!lex_number_is_eight_digits(chunk))
+        {
+            break;
+        }
+        if (__builtin_mul_overflow(result, 100000000ull, &result) ||
+            __builtin_add_overflow(result, lex_number_parse_eight_digits(chunk), &result))
+        {
+            *overflow = true;
+        }
+        i += 8;
+    }
+#endif
+    for (; i < len && str[i] >= '0' && str[i] <= '9'; i++)
+    {
+        if (__builtin_mul_overflow(result, 10ull, &result) ||
+            __builtin_add_overflow(result, (unsigned long long)(str[i] - '0'), &result))
+        {
+            *overflow = true;
+        }
+    }
+
+    *value = result;
+    return i;
+}
+
+// 2, 8, 16 进制; 遇到不属于该进制的十进制数字时返回其下标, 由调用者报错
+static size_t lex_number_parse_radix(const char *str, size_t len, int shift, unsigned long long *value, bool *overflow)
+{
+    unsigned long long result = 0;
+    int radix = 1 << shift;
+    size_t i = 0;
+    for (; i < len; i++)
+    {
+        int digit = lex_number_digit_value(str[i]);
+        if (digit >= radix)
+        {
+            break;
+        }
+        if (result >> (64 - shift))
+        {
+            *overflow = true;
+        }
+        result = (result << shift) | digit;
+    }
+
+    *value = result;
+    return i;
+}
+
+// 读取 U, L, LL 后缀的任意组合; 兼容原有的 f 后缀
+static size_t lex_number_parse_suffix(const char *str, size_t len, struct token_literal *literal)
+{
+    size_t i = 0;
+    bool seen_unsigned = false;
+    bool seen_long = false;
+    while (i < len)
+    {
+        char c = str[i];
+        if ((c == 'u' || c == 'U') && !seen_unsigned)
+        {
+            seen_unsigned = true;
+            literal->is_unsigned = true;
+            i++;
+        }
+        else if ((c == 'l' || c == 'L') && !seen_long)
+        {
+            seen_long = true;
+            // LL 与 ll 必须大小写一致
+            if (i + 1 < len && str[i + 1] == c)
+            {
+                literal->type = NUMBER_TYPE_LONG_LONG;
+                i += 2;
+            }
+            else
+            {
+                literal->type = NUMBER_TYPE_LONG;
+                i++;
+            }
+        }
+        else if (c == 'f' && i == 0)
+        {
+            literal->type = NUMBER_TYPE_FLOAT;
+            literal->dval = (float)literal->llnum;
+            return 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+// 浮点数的二进制格式
+struct lex_float_format
+{
+    int mantissa_bits;
+    int exponent_bias;
+    int infinite_exponent;
+};
+
+static const struct lex_float_format lex_float_double = {52, 1023, 0x7FF};
+static const struct lex_float_format lex_float_single = {23, 127, 0xFF};
+
+/**
+ * Eisel-Lemire: 用 w 乘以 5^q 的 128 位近似值得到 w * 10^q 的二进制表示.
+ * 成功时在 bits 中返回浮点数的位模式; 无法确定舍入方向, 或结果是非规格化数/溢出时返回 false.
+ */
+static bool lex_number_eisel_lemire(uint64_t w, long q, const struct lex_float_format *format, uint64_t *bits)
+{
+    if (w == 0)
+    {
+        *bits = 0;
+        return true;
+    }
+    if (q < POW5_MIN_EXPONENT || q > POW5_MAX_EXPONENT)
+    {
+        return false;
+    }
+
+    const uint64_t *power = pow5_table[q - POW5_MIN_EXPONENT];
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    // 217706 / 2^16 约为 log2(10)
+    uint64_t exponent = (uint64_t)(((217706 * q) >> 16) + 64 + format->exponent_bias - lz);
+
+    // 结果只需要最高的 mantissa_bits + 3 位, 低位全为 1 时才需要更精确的乘积
+    int shift = 64 - format->mantissa_bits - 3;
+    uint64_t mask = (1ull << shift) - 1;
+    unsigned __int128 product = (unsigned __int128)w * power[0];
+    uint64_t hi = product >> 64;
+    uint64_t lo = (uint64_t)product;
+    if ((hi & mask) == mask && lo + w < w)
+    {
+        unsigned __int128 low_product = (unsigned __int128)w * power[1];
+        uint64_t merged_lo = lo + (uint64_t)(low_product >> 64);
+        uint64_t merged_hi = hi + (merged_lo < lo);
+        if ((merged_hi & mask) == mask && merged_lo + 1 == 0 && (uint64_t)low_product + w < w)
+        {
+            return false;
+        }
+        hi = merged_hi;
+        lo = merged_lo;
+    }
+
+    // 保留 mantissa_bits + 2 位, 最低位用于舍入
+    uint64_t msb = hi >> 63;
+    uint64_t mantissa = hi >> (msb + shift);
+    exponent -= 1 ^ msb;
+
+    // 恰好在两个浮点数中间, 近似值不足以判断
+    if (lo == 0 && (hi & mask) == 0 && (mantissa & 3) == 1)
+    {
+        return false;
+    }
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >> (format->mantissa_bits + 1))
+    {
+        mantissa >>= 1;
+        exponent++;
+    }
+    if (exponent - 1 >= (uint64_t)format->infinite_exponent - 1)
+    {
+        return false;
+    }
+
+    *bits = exponent << format->mantissa_bits | (mantissa & ((1ull << format->mantissa_bits) - 1));
+    return true;
+}
+
+// 10^0 到 10^22 都可以精确地表示为 double
+static const double lex_number_exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// 把 w * 10^q 转换为 literal->type 对应的浮点数, truncated 表示 w 之后还有被舍去的非零数位
+static bool lex_number_decimal_to_float(uint64_t w, long q, bool truncated, struct token_literal *literal)
+{
+    bool single = literal->type == NUMBER_TYPE_FLOAT;
+    const struct lex_float_format *format = single ? &lex_float_single : &lex_float_double;
+
+    // w 与 10^|q| 都能精确表示时只需一次舍入
+    if (!single && !truncated && w <= (1ull << 53) && q >= -22 && q <= 22)
+    {
+        literal->dval = q < 0 ? (double)w / lex_number_exact_powers[-q] : (double)w * lex_number_exact_powers[q];
+        return true;
+    }
+
+    uint64_t bits = 0;
+    if (!lex_number_eisel_lemire(w, q, format, &bits))
+    {
+        return false;
+    }
+    if (truncated)
+    {
+        // 真实值在 w 与 w + 1 之间, 两端舍入到同一个浮点数时结果才确定
+        uint64_t upper = 0;
+        if (!lex_number_eisel_lemire(w + 1, q, format, &upper) || upper != bits)
+        {
+            return false;
+        }
+    }
+
+    if (single)
+    {
+        uint32_t single_bits = (uint32_t)bits;
+        float value;
+        memcpy(&value, &single_bits, sizeof(value));
+        literal->dval = value;
+    }
+    else
+    {
+        memcpy(&literal->dval, &bits, sizeof(literal->dval));
+    }
+    return true;
+}
+
+// 快速路径无法处理时用 strtod 转换 str 的前 len 个字节
+static void lex_number_float_slow(const char *str, size_t len, struct token_literal *literal)
+{
+    char stack_copy[128];
+    char *copy = len < sizeof(stack_copy) ? stack_copy : malloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    literal->dval = literal->type == NUMBER_TYPE_FLOAT ? strtof(copy, NULL) : strtod(copy, NULL);
+    if (copy != stack_copy)
+    {
+        free(copy);
+    }
+}
+
+// 读取 e/p 之后的指数, 指数绝对值过大时截断, 结果仍然是 0 或无穷大
+static size_t lex_number_parse_exponent(const char *str, size_t len, long *exponent, const char **error)
+{
+    size_t i = 1;
+    bool negative = false;
+    if (i < len && (str[i] == '+' || str[i] == '-'))
+    {
+        negative = str[i] == '-';
+        i++;
+    }
+    if (i >= len || str[i] < '0' || str[i] > '9')
+    {
+        *error = "浮点数的指数缺少数位";
+        return 0;
+    }
+
+    long value = 0;
+    for (; i < len && str[i] >= '0' && str[i] <= '9'; i++)
+    {
+        if (value < 100000)
+        {
+            value = value * 10 + (str[i] - '0');
+        }
+    }
+    *exponent = negative ? -value : value;
+    return i;
+}
+
+// 浮点数后缀: f 为 float, l 与无后缀为 double
+static size_t lex_number_parse_float_suffix(const char *str, size_t len, struct token_literal *literal)
+{
+    literal->type = NUMBER_TYPE_DOUBLE;
+    if (len > 0 && (str[0] == 'f' || str[0] == 'F'))
+    {
+        literal->type = NUMBER_TYPE_FLOAT;
+        return 1;
+    }
+    if (len > 0 && (str[0] == 'l' || str[0] == 'L'))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+// 最多保留 19 位有效数字, 保证不超出 uint64_t
+#define LEX_NUMBER_MAX_DIGITS 19
+
+/**
+ * 十进制浮点数: 有效数字放入 w, 小数点与指数折算到 q 中, 值为 w * 10^q.
+ */
+static size_t lex_number_parse_decimal_float(const char *str, size_t len, struct token_literal *literal, const char **error)
+{
+    uint64_t w = 0;
+    long q = 0;
+    int digits = 0;
+    bool truncated = false;
+    bool fraction = false;
+    size_t i = 0;
+    for (; i < len; i++)
+    {
+        char c = str[i];
+        if (c == '.' && !fraction)
+        {
+            fraction = true;
+            continue;
+        }
+        if (c < '0' || c > '9')
+        {
+            break;
+        }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t chunk;
+        if (w != 0 && digits + 8 <= LEX_NUMBER_MAX_DIGITS && i + 8 <= len &&
+            (memcpy(&chunk, str + i, sizeof(chunk)), lex_number_is_eight_digits(chunk)))
+        {
+            w = w * 100000000 + lex_number_parse_eight_digits(chunk);
+            digits += 8;
+            q -= fraction ? 8 : 0;
+            i += 7;
+            continue;
+        }
+#endif
+        if (w == 0 && c == '0')
+        {
+            // 前导零不占有效数字
+            q -= fraction;
+        }
+        else if (digits < LEX_NUMBER_MAX_DIGITS)
+        {
+            w = w * 10 + (c - '0');
+            digits++;
+            q -= fraction;
+        }
+        else
+        {
+            truncated |= c != '0';
+            q += !fraction;
+        }
+    }
+
+    if (i < len && (str[i] == 'e' || str[i] == 'E'))
+    {
+        long exponent = 0;
+        size_t exponent_len = lex_number_parse_exponent(str + i, len - i, &exponent, error);
+        if (*error)
+        {
+            return 0;
+        }
+        q += exponent;
+        i += exponent_len;
+    }
+
+    size_t number_len = i;
+    i += lex_number_parse_float_suffix(str + i, len - i, literal);
+    if (!lex_number_decimal_to_float(w, q, truncated, literal))
+    {
+        lex_number_float_slow(str, number_len, literal);
+    }
+    return i;
+}
+
+/**
+ * 十六进制浮点数 0x1.8p3: 值为 mantissa * 2^exponent, 必须带有 p 指数.
+ * 有效位不超过目标格式的精度时 ldexp 只舍入一次, 否则交给 strtod.
+ */
+static size_t lex_number_parse_hex_float(const char *str, size_t len, struct token_literal *literal, const char **error)
+{
+    uint64_t mantissa = 0;
+    long exponent = 0;
+    bool truncated = false;
+    bool fraction = false;
+    bool has_digits = false;
+    size_t i = 2;
+    for (; i < len; i++)
+    {
+        if (str[i] == '.' && !fraction)
+        {
+            fraction = true;
+            continue;
+        }
+        int digit = lex_number_digit_value(str[i]);
+        if (digit >= 16)
+        {
+            break;
+        }
+
+        has_digits = true;
+        if (mantissa >> 60 == 0)
+        {
+            mantissa = mantissa << 4 | digit;
+            exponent -= fraction ? 4 : 0;
+        }
+        else
+        {
+            truncated |= digit != 0;
+            exponent += fraction ? 0 : 4;
+        }
+    }
+
+    if (!has_digits)
+    {
+        *error = "十六进制数字缺少数位";
+        return 0;
+    }
+    if (i >= len || (str[i] != 'p' && str[i] != 'P'))
+    {
+        *error = "十六进制浮点数缺少 p 指数";
+        return 0;
+    }
+    long binary_exponent = 0;
+    size_t exponent_len = lex_number_parse_exponent(str + i, len - i, &binary_exponent, error);
+    if (*error)
+    {
+        return 0;
+    }
+    i += exponent_len;
+
+    size_t number_len = i;
+    i += lex_number_parse_float_suffix(str + i, len - i, literal);
+    int precision = literal->type == NUMBER_TYPE_FLOAT ? 24 : 53;
+    if (!truncated && mantissa >> precision == 0)
+    {
+        exponent += binary_exponent;
+        literal->dval = literal->type == NUMBER_TYPE_FLOAT ? ldexpf((float)mantissa, exponent) : ldexp((double)mantissa, exponent);
+    }
+    else
+    {
+        lex_number_float_slow(str, number_len, literal);
+    }
+    return i;
+}
+
+// 跳过数位后遇到小数点或指数, 说明是浮点数
+static bool lex_number_is_float(const char *str, size_t len, bool hex)
+{
+    size_t i = hex ? 2 : 0;
+    while (i < len && lex_number_digit_value(str[i]) < (hex ? 16 : 10))
+    {
+        i++;
+    }
+    if (i >= len)
+    {
+        return false;
+    }
+    return str[i] == '.' || (hex ? str[i] == 'p' || str[i] == 'P' : str[i] == 'e' || str[i] == 'E');
+}
+
+/**
+ * 解析 str 开头的数字字面量. 整数: 0x 十六进制, 0b 二进制, 0 开头为八进制, 其余为十进制,
+ * 之后可以跟 U/L/LL 后缀; 浮点数: 十进制或 0x 开头的十六进制, 可以跟 f/l 后缀.
+ * 返回读取的字节数, 出错时返回 0 并在 error 中给出原因.
+ */
+size_t lex_number_parse(const char *str, size_t len, struct token_literal *literal, const char **error)
+{
+    *literal = (struct token_literal){.type = NUMBER_TYPE_NORMAL};
+    *error = NULL;
+
+    bool hex = len >= 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+    if (lex_number_is_float(str, len, hex))
+    {
+        return hex ? lex_number_parse_hex_float(str, len, literal, error) : lex_number_parse_decimal_float(str, len, literal, error);
+    }
+
+    bool overflow = false;
+    size_t i = 0;
+    if (len >= 2 && str[0] == '0' && (hex || str[1] == 'b' || str[1] == 'B'))
+    {
+        size_t digits = lex_number_parse_radix(str + 2, len - 2, hex ? 4 : 1, &literal->llnum, &overflow);
+        if (digits == 0)
+        {
+            *error = hex ? "十六进制数字缺少数位" : "二进制数字缺少数位";
+            return 0;
+        }
+        i = 2 + digits;
+        if (!hex && i < len && str[i] >= '2' && str[i] <= '9')
+        {
+            *error = "二进制数字中出现了无效的数位";
+            return 0;
+        }
+    }
+    else if (str[0] == '0')
+    {
+        i = 1 + lex_number_parse_radix(str + 1, len - 1, 3, &literal->llnum, &overflow);
+        if (i < len && (str[i] == '8' || str[i] == '9'))
+        {
+            *error = "八进制数字中出现了无效的数位";
+            return 0;
+        }
+    }
+    else
+    {
+        i = lex_number_parse_decimal(str, len, &literal->llnum, &overflow);
+    }
+
+    if (overflow)
+    {
+        *error = "整数字面量超出范围";
+        return 0;
+    }
+
+    return i + lex_number_parse_suffix(str + i, len - i, literal);
+}
@@ -0,0 +1,325 @@
+#include "compiler.h"
+#include "token.h"
+#include "../helpers/vector.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+// 小于这个大小的文件直接顺序分析
+#define LEX_PARALLEL_MIN_SIZE (1024 * 1024)
+// 每个分块至少这么大, 分块数取线程数的 4 倍以平衡负载
+#define LEX_PARALLEL_MIN_CHUNK_SIZE (256 * 1024)
+#define LEX_PARALLEL_CHUNKS_PER_THREAD 4
+
+/**
+ * 一个分块从某一行的行首开始推测地分析, 假设此处不在注释或字符串内部。
+ * 分块有自己的 compile_process 副本: 独立的读取位置, 驻留表与字面量池,
+ * 拼接时再把编号映射回主 compile_process。
+ */
+struct lex_chunk
+{
+    size_t start;
+    size_t end;
+
+    cfile input;
+    compile_process compiler;
+    lex_process *lexer;
+
+    // 推测分析时遇到词法错误
+    bool failed;
+};
+
+struct lex_parallel_job
+{
+    struct lex_chunk *chunks;
+    int total;
+    atomic_int next;
+};
+
+static void lex_chunk_run(struct lex_chunk *chunk)
+{
+    jmp_buf recover;
+    chunk->lexer->recover = &recover;
+    if (setjmp(recover))
+    {
+        chunk->failed = true;
+        return;
+    }
+
+    lex_begin(chunk->lexer);
+    struct token *token = NULL;
+    while ((token = lex_next_token(chunk->lexer)))
+    {
+        vec_token_push(chunk->lexer->token_vec, *token);
+        chunk->lexer->last_token = vec_token_back(chunk->lexer->token_vec);
+    }
+}
+
+static void *lex_parallel_worker(void *arg)
+{
+    struct lex_parallel_job *job = arg;
+    int index = 0;
+    while ((index = atomic_fetch_add(&job->next, 1)) < job->total)
+    {
+        lex_chunk_run(&job->chunks[index]);
+    }
+    return NULL;
+}
+
+static void lex_chunk_init(struct lex_chunk *chunk, lex_process *process, size_t start, size_t end)
+{
+    compile_process *compiler = process->compiler;
+    chunk->start = start;
+    chunk->end = end;
+    chunk->failed = false;
+
+    // 读取可以越过分块末尾, 跨越边界的 token 完整地读出
+    chunk->input = *compiler->input_file;
+    chunk->input.cur = chunk->input.data + start;
+    chunk->input.line_starts = NULL;
+
+    chunk->compiler = *compiler;
+    chunk->compiler.input_file = &chunk->input;
+    chunk->compiler.strings = intern_table_create();
+    chunk->compiler.literals = vector_create(sizeof(struct token_literal));
+    // 分块在工作线程中分析, 不能与其他线程共用 arena
+    chunk->compiler.arena = NULL;
+
+    chunk->lexer = lex_process_create(&chunk->compiler, process->function, NULL);
+    chunk->lexer->flags |= LEX_PROCESS_FLAG_CHUNK;
+    chunk->lexer->limit = end - start;
+}
+
+static void lex_chunk_free(struct lex_chunk *chunk)
+{
+    intern_table_free(chunk->compiler.strings);
+    vector_free(chunk->compiler.literals);
+    lex_process_free(chunk->lexer);
+}
+
+// 在 offset 之后的第一个行首处切分
+static size_t lex_parallel_split_point(cfile *input, size_t offset)
+{
+    size_t size = input->end - input->data;
+    if (offset >= size)
+    {
+        return size;
+    }
+    const char *newline = memchr(input->data + offset, '\n', size - offset);
+    return newline ? (size_t)(newline - input->data) + 1 : size;
+}
+
+/**
+ * 把分块中的 token 追加到结果中, 驻留编号与字面量编号换成主 compile_process 中的编号.
+ * first 之前的 token 已由顺序分析代替.
+ */
+static void lex_chunk_append(struct lex_chunk *chunk, int first, lex_process *process)
+{
+    compile_process *compiler = process->compiler;
+    struct intern_table *strings = chunk->compiler.strings;
+    uint32_t *remap = malloc((strings->count + 1) * sizeof(uint32_t));
+    for (int i = 0; i < strings->count; i++)
+    {
+        remap[i] = intern_string_id(compiler->strings, strings->entries[i].str, strings->entries[i].len);
+    }
+
+    uint32_t literal_base = vector_count(compiler->literals);
+    for (int i = 0; i < vector_count(chunk->compiler.literals); i++)
+    {
+        vector_push(compiler->literals, vector_at(chunk->compiler.literals, i));
+    }
+
+    VEC(token) *tokens = chunk->lexer->token_vec;
+    vector_reserve(&process->token_vec->base, vec_token_count(process->token_vec) + vec_token_count(tokens) - first);
+    for (int i = first; i < vec_token_count(tokens); i++)
+    {
+        struct token token = *vec_token_at(tokens, i);
+        token.offset += chunk->start;
+        switch (token.type)
+        {
+        case TOKEN_TYPE_IDENTIFIER:
+        case TOKEN_TYPE_STRING:
+        case TOKEN_TYPE_COMMENT:
+            token.str_id = remap[token.str_id];
+            break;
+        case TOKEN_TYPE_NUMBER:
+            token.literal_id += literal_base;
+            break;
+        }
+        vec_token_push(process->token_vec, token);
+    }
+    free(remap);
+}
+
+// 分块中与 target 起点, 类型和长度都相同的 token 的下标, 没有时返回 -1
+static int lex_chunk_find_token(struct lex_chunk *chunk, int *cursor, struct token *target)
+{
+    VEC(token) *tokens = chunk->lexer->token_vec;
+    size_t offset = target->offset;
+    while (*cursor < vec_token_count(tokens))
+    {
+        struct token *token = vec_token_at(tokens, *cursor);
+        size_t token_offset = token->offset + chunk->start;
+        if (token_offset == offset && token->type == target->type && token->length == target->length)
+        {
+            return *cursor;
+        }
+        if (token_offset > offset)
+        {
+            break;
+        }
+        (*cursor)++;
+    }
+    return -1;
+}
+
+/**
+ * 分块的起点落在注释或字符串内部时, 从上一个 token 的结尾 offset 开始顺序重新分析.
+ * 词法分析器在 token 之间的状态只有上一个 token, 分析前先放入已有的最后一个 token;
+ * 一旦重新分析出的 token 与推测结果中的某个 token 完全相同, 其后的推测结果就都是正确的.
+ */
+static void lex_chunk_relex(struct lex_chunk *chunk, size_t offset, lex_process *process)
+{
+    cfile *input = process->compiler->input_file;
+    input->cur = input->data + offset;
+    lex_process *lexer = lex_process_create(process->compiler, process->function, NULL);
+    lexer->flags |= LEX_PROCESS_FLAG_CHUNK;
+    lexer->limit = chunk->end - offset;
+    lex_begin(lexer);
+    struct token *last = vec_token_back_or_null(process->token_vec);
+    struct token previous = last ? *last : (struct token){0};
+    lexer->last_token = last ? &previous : NULL;
+
+    int cursor = 0;
+    struct token *token = NULL;
+    while ((token = lex_next_token(lexer)))
+    {
+        token->offset += offset;
+        int index = chunk->failed ? -1 : lex_chunk_find_token(chunk, &cursor, token);
+        if (index >= 0)
+        {
+            lex_chunk_append(chunk, index, process);
+            break;
+        }
+        vec_token_push(process->token_vec, *token);
+        lexer->last_token = vec_token_back(process->token_vec);
+    }
+    lex_process_free(lexer);
+}
+
+// 拼接后统一计算跨越分块的状态: 括号深度与 token 之后的空白
+static void lex_parallel_fixup(lex_process *process)
+{
+    compile_process *compiler = process->compiler;
+    struct token *tokens = vector_data_ptr(&process->token_vec->base);
+    int count = vec_token_count(process->token_vec);
+    size_t size = compiler->input_file->end - compiler->input_file->data;
+    int depth = 0;
+    for (int i = 0; i < count; i++)
+    {
+        struct token *token = &tokens[i];
+        if (token_is_symbol(token, ')'))
+        {
+            depth--;
+            if (depth < 0)
+            {
+                compiler->offset = token->offset;
+                compiler_error(compiler, "Unexpected ')'\n");
+            }
+        }
+
+        token->flags &= ~(TOKEN_FLAG_IN_EXPRESSION | TOKEN_FLAG_WHITESPACE);
+        if (depth > 0)
+        {
+            token->flags |= TOKEN_FLAG_IN_EXPRESSION;
+        }
+        // 词法分析器只会跳过空白, token 之间有间隔就说明后面跟着空白
+        size_t next_offset = i + 1 < count ? tokens[i + 1].offset : size;
+        if (next_offset > token->offset + token->length)
+        {
+            token->flags |= TOKEN_FLAG_WHITESPACE;
+        }
+
+        if (token_is_operator(token, OP_LPAREN))
+        {
+            depth++;
+        }
+    }
+}
+
+// 分块并行词法分析, 结果与 lex() 相同; 只用于读取输入文件的词法分析器
+int lex_parallel(lex_process *process)
+{
+    cfile *input = process->compiler->input_file;
+    size_t size = input->end - input->data;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (size < LEX_PARALLEL_MIN_SIZE || threads < 2)
+    {
+        return lex(process);
+    }
+
+    size_t chunk_size = size / (threads * LEX_PARALLEL_CHUNKS_PER_THREAD);
+    if (chunk_size < LEX_PARALLEL_MIN_CHUNK_SIZE)
+    {
+        chunk_size = LEX_PARALLEL_MIN_CHUNK_SIZE;
+    }
+
+    struct lex_parallel_job job = {0};
+    job.chunks = calloc(size / chunk_size + 1, sizeof(struct lex_chunk));
+    size_t start = 0;
+    while (start < size)
+    {
+        size_t end = lex_parallel_split_point(input, start + chunk_size);
+        lex_chunk_init(&job.chunks[job.total++], process, start, end);
+        start = end;
+    }
+    atomic_init(&job.next, 0);
+
+    if (threads > job.total)
+    {
+        threads = job.total;
+    }
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    for (long i = 0; i < threads; i++)
+    {
+        pthread_create(&workers[i], NULL, lex_parallel_worker, &job);
+    }
+    for (long i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    // 按顺序拼接, 第一个分块从文件开头开始, 总是正确的
+    size_t offset = 0;
+    for (int i = 0; i < job.total; i++)
+    {
+        struct lex_chunk *chunk = &job.chunks[i];
+        if (offset >= chunk->end)
+        {
+            // 整个分块都在上一个 token (跨越多个分块的注释或字符串) 之内
+        }
+        else if (chunk->failed || offset > chunk->start)
+        {
+            lex_chunk_relex(chunk, offset > chunk->start ? offset : chunk->start, process);
+        }
+        else
+        {
+            lex_chunk_append(chunk, 0, process);
+        }
+
+        struct token *last_token = vector_back_or_null(&process->token_vec->base);
+        if (last_token)
+        {
+            offset = last_token->offset + last_token->length;
+        }
+        lex_chunk_free(chunk);
+    }
+    free(job.chunks);
+    input->cur = input->end;
+
+    lex_parallel_fixup(process);
+    print_token_vec(process->compiler, process->token_vec);
+    return LEXICAL_ANALYSIS_ALL_OK;
+}
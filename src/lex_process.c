@@ -7,21 +7,26 @@ lex_process *lex_process_create(compile_process *compiler, lex_process_functions
     if (!process)
         return NULL;
     // printf("lex_process is not null\n");
+    process->flags = 0;
     process->compiler = compiler;
+    process->limit = SIZE_MAX;
+    process->recover = NULL;
     process->function = functions;
     // printf("%d", sizeof(struct token));
-    process->token_vec = vector_create(sizeof(struct token));
+    process->token_vec = vec_token_create();
+    // 预处理器会为每个头文件和 ## 拼接创建临时的分析器, 暂存区从编译进程的 arena 分配
+    process->scratch_buffer = compiler->arena ? buffer_create_arena(compiler->arena) : buffer_create();
 
     process->private = data;
-    process->pos.col = 1;
-    process->pos.line = 1;
+    process->base = 0;
 
     return process;
 }
 
 void lex_process_free(lex_process *process)
 {
-    vector_free(process->token_vec);
+    vector_free(&process->token_vec->base);
+    buffer_free(process->scratch_buffer);
     free(process);
 }
 
@@ -30,7 +35,7 @@ void *lex_process_private(lex_process *process)
     return process->private;
 }
 
-struct vector *lex_process_tokens(lex_process *process)
+VEC(token) *lex_process_tokens(lex_process *process)
 {
     return process->token_vec;
 }
@@ -0,0 +1,153 @@
+#include "compiler.h"
+#include "../helpers/vector.h"
+
+/**
+ * 词法分析器的批量扫描. 每个函数返回 str 中第一个满足条件的字节下标,
+ * 找不到时返回 len. AVX2 每次比较 32 个字节, SSE2 每次 16 个, 剩余部分逐字节处理.
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LEX_SCAN_WIDTH 32
+typedef __m256i lex_vec;
+#define lex_vec_load(ptr) _mm256_loadu_si256((const __m256i *)(ptr))
+#define lex_vec_set1(c) _mm256_set1_epi8(c)
+#define lex_vec_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#define lex_vec_gt(a, b) _mm256_cmpgt_epi8(a, b)
+#define lex_vec_or(a, b) _mm256_or_si256(a, b)
+#define lex_vec_and(a, b) _mm256_and_si256(a, b)
+#define lex_vec_mask(v) ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LEX_SCAN_WIDTH 16
+typedef __m128i lex_vec;
+#define lex_vec_load(ptr) _mm_loadu_si128((const __m128i *)(ptr))
+#define lex_vec_set1(c) _mm_set1_epi8(c)
+#define lex_vec_eq(a, b) _mm_cmpeq_epi8(a, b)
+#define lex_vec_gt(a, b) _mm_cmpgt_epi8(a, b)
+#define lex_vec_or(a, b) _mm_or_si128(a, b)
+#define lex_vec_and(a, b) _mm_and_si128(a, b)
+#define lex_vec_mask(v) ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+static bool lex_scan_is_identifier_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+size_t lex_scan_until_char(const char *str, size_t len, char c)
+{
+    size_t i = 0;
+#ifdef LEX_SCAN_WIDTH
+    lex_vec target = lex_vec_set1(c);
+    for (; i + LEX_SCAN_WIDTH <= len; i += LEX_SCAN_WIDTH)
+    {
+        uint32_t mask = lex_vec_mask(lex_vec_eq(lex_vec_load(str + i), target));
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < len && str[i] != c; i++)
+    {
+    }
+    return i;
+}
+
+size_t lex_scan_until_either(const char *str, size_t len, char a, char b)
+{
+    size_t i = 0;
+#ifdef LEX_SCAN_WIDTH
+    lex_vec target_a = lex_vec_set1(a);
+    lex_vec target_b = lex_vec_set1(b);
+    for (; i + LEX_SCAN_WIDTH <= len; i += LEX_SCAN_WIDTH)
+    {
+        lex_vec chunk = lex_vec_load(str + i);
+        uint32_t mask = lex_vec_mask(lex_vec_or(lex_vec_eq(chunk, target_a), lex_vec_eq(chunk, target_b)));
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < len && str[i] != a && str[i] != b; i++)
+    {
+    }
+    return i;
+}
+
+// 返回 "*/" 中 '*' 的下标
+size_t lex_scan_comment_end(const char *str, size_t len)
+{
+    size_t i = lex_scan_until_char(str, len, '*');
+    while (i + 1 < len)
+    {
+        if (str[i + 1] == '/')
+        {
+            return i;
+        }
+        i++;
+        i += lex_scan_until_char(str + i, len - i, '*');
+    }
+    return len;
+}
+
+size_t lex_scan_identifier(const char *str, size_t len)
+{
+    size_t i = 0;
+#ifdef LEX_SCAN_WIDTH
+    // 非 ASCII 字节在有符号比较中为负数, 不会落在任何范围内
+    lex_vec lower_bound = lex_vec_set1('a' - 1);
+    lex_vec upper_bound = lex_vec_set1('z' + 1);
+    lex_vec digit_lower_bound = lex_vec_set1('0' - 1);
+    lex_vec digit_upper_bound = lex_vec_set1('9' + 1);
+    lex_vec case_bit = lex_vec_set1(0x20);
+    lex_vec underscore = lex_vec_set1('_');
+    for (; i + LEX_SCAN_WIDTH <= len; i += LEX_SCAN_WIDTH)
+    {
+        lex_vec chunk = lex_vec_load(str + i);
+        lex_vec lower = lex_vec_or(chunk, case_bit);
+        lex_vec alpha = lex_vec_and(lex_vec_gt(lower, lower_bound), lex_vec_gt(upper_bound, lower));
+        lex_vec digit = lex_vec_and(lex_vec_gt(chunk, digit_lower_bound), lex_vec_gt(digit_upper_bound, chunk));
+        lex_vec ident = lex_vec_or(lex_vec_or(alpha, digit), lex_vec_eq(chunk, underscore));
+        uint32_t mask = ~lex_vec_mask(ident) & (uint32_t)((1ull << LEX_SCAN_WIDTH) - 1);
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < len && lex_scan_is_identifier_char(str[i]); i++)
+    {
+    }
+    return i;
+}
+
+// 把 str 中每个换行符之后的偏移追加到 line_starts (元素为 uint32_t)
+void lex_scan_line_starts(const char *str, size_t len, struct vector *line_starts)
+{
+    size_t i = 0;
+#ifdef LEX_SCAN_WIDTH
+    lex_vec newline = lex_vec_set1('\n');
+    for (; i + LEX_SCAN_WIDTH <= len; i += LEX_SCAN_WIDTH)
+    {
+        // 一次比较取出整块中所有换行符, 短行较多时比逐个 memchr 快
+        uint32_t mask = lex_vec_mask(lex_vec_eq(lex_vec_load(str + i), newline));
+        while (mask)
+        {
+            uint32_t offset = i + __builtin_ctz(mask) + 1;
+            vector_push(line_starts, &offset);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < len; i++)
+    {
+        if (str[i] == '\n')
+        {
+            uint32_t offset = i + 1;
+            vector_push(line_starts, &offset);
+        }
+    }
+}
@@ -3,17 +3,87 @@
 #include "../helpers/vector.h"
 #include <string.h>
 #include <assert.h>
-#include <ctype.h>
 
-#define LEX_GETC_IF(buffer, c, exp)     \
-    for (c = peekc(); exp; c = peekc()) \
-    {                                   \
-        buffer_write(buffer, c);        \
-        nextc();                        \
-    }
+// 字符分类, 词法分析器的每个字节只查一次表
+enum
+{
+    CHAR_CLASS_INVALID,
+    CHAR_CLASS_WHITESPACE,
+    CHAR_CLASS_NEWLINE,
+    CHAR_CLASS_DIGIT,
+    CHAR_CLASS_IDENTIFIER,
+    CHAR_CLASS_OPERATOR,
+    CHAR_CLASS_SYMBOL,
+    CHAR_CLASS_STRING,
+    CHAR_CLASS_QUOTE,
+    CHAR_CLASS_EOF
+};
 
-static lex_process *lex_process_instance;
-static token tem_token;
+static const unsigned char lex_char_class[256] = {
+    [' '] = CHAR_CLASS_WHITESPACE,
+    ['\t'] = CHAR_CLASS_WHITESPACE,
+    ['\r'] = CHAR_CLASS_WHITESPACE,
+    ['\v'] = CHAR_CLASS_WHITESPACE,
+    ['\f'] = CHAR_CLASS_WHITESPACE,
+    ['\n'] = CHAR_CLASS_NEWLINE,
+    ['0' ... '9'] = CHAR_CLASS_DIGIT,
+    ['a' ... 'z'] = CHAR_CLASS_IDENTIFIER,
+    ['A' ... 'Z'] = CHAR_CLASS_IDENTIFIER,
+    ['_'] = CHAR_CLASS_IDENTIFIER,
+    ['+'] = CHAR_CLASS_OPERATOR,
+    ['-'] = CHAR_CLASS_OPERATOR,
+    ['*'] = CHAR_CLASS_OPERATOR,
+    ['/'] = CHAR_CLASS_OPERATOR,
+    ['>'] = CHAR_CLASS_OPERATOR,
+    ['<'] = CHAR_CLASS_OPERATOR,
+    ['^'] = CHAR_CLASS_OPERATOR,
+    ['%'] = CHAR_CLASS_OPERATOR,
+    ['!'] = CHAR_CLASS_OPERATOR,
+    ['='] = CHAR_CLASS_OPERATOR,
+    ['~'] = CHAR_CLASS_OPERATOR,
+    ['|'] = CHAR_CLASS_OPERATOR,
+    ['&'] = CHAR_CLASS_OPERATOR,
+    ['('] = CHAR_CLASS_OPERATOR,
+    ['['] = CHAR_CLASS_OPERATOR,
+    [','] = CHAR_CLASS_OPERATOR,
+    ['.'] = CHAR_CLASS_OPERATOR,
+    ['?'] = CHAR_CLASS_OPERATOR,
+    ['{'] = CHAR_CLASS_SYMBOL,
+    ['}'] = CHAR_CLASS_SYMBOL,
+    [':'] = CHAR_CLASS_SYMBOL,
+    [';'] = CHAR_CLASS_SYMBOL,
+    ['#'] = CHAR_CLASS_SYMBOL,
+    ['\\'] = CHAR_CLASS_SYMBOL,
+    [')'] = CHAR_CLASS_SYMBOL,
+    [']'] = CHAR_CLASS_SYMBOL,
+    ['"'] = CHAR_CLASS_STRING,
+    ['\''] = CHAR_CLASS_QUOTE,
+    // peek_char 在文件尾返回 EOF (-1)
+    [(unsigned char)EOF] = CHAR_CLASS_EOF,
+};
+
+#define LEX_CHAR_CLASS(c) (lex_char_class[(unsigned char)(c)])
+// 预估 token 数用的平均每个 token 占的源码字节数 (含空白), 偏小只会多占一些内存
+#define LEX_BYTES_PER_TOKEN 4
+
+// 分块并行词法分析时每个线程各有一份词法分析器状态
+static _Thread_local lex_process *lex_process_instance;
+
+// 报告词法错误; 语法分析与词法分析可能交替进行, 先把位置切换到词法分析器的当前位置.
+// 推测执行的分块遇到错误时不退出, 跳回分块的起点, 由调用者按顺序重新分析
+#define lex_error(...)                                                  \
+    do                                                                  \
+    {                                                                   \
+        if (lex_process_instance->recover)                              \
+        {                                                               \
+            longjmp(*lex_process_instance->recover, 1);                 \
+        }                                                               \
+        lex_process_instance->compiler->offset = lex_process_instance->base + lex_offset(); \
+        compiler_error(lex_process_instance->compiler, __VA_ARGS__);    \
+    } while (0)
+static _Thread_local token tem_token;
+// 当前 token 的起始偏移
+static _Thread_local size_t token_start;
 token *read_next_token();
 bool lex_is_in_expression();
 
@@ -21,24 +91,28 @@ static char peekc()
 {
     return lex_process_instance->function->peek_char(lex_process_instance);
 }
-static void pushc(char c)
+static char nextc()
 {
-    lex_process_instance->function->push_char(lex_process_instance, c);
+    return lex_process_instance->function->next_char(lex_process_instance);
 }
-static char nextc()
+
+// 取出尚未读取的连续输入
+static const char *lex_span(size_t *len)
 {
-    char c = lex_process_instance->function->next_char(lex_process_instance);
-    if (lex_is_in_expression())
-    {
-        buffer_write(lex_process_instance->parentheses_buffer, c);
-    }
-    lex_process_instance->pos.col++;
-    if (c == '\n')
-    {
-        lex_process_instance->pos.line++;
-        lex_process_instance->pos.col = 1;
-    }
-    return c;
+    return lex_process_instance->function->peek_span(lex_process_instance, len);
+}
+
+// 当前读取位置相对源码起始的偏移
+static size_t lex_offset()
+{
+    size_t len = 0;
+    return lex_span(&len) - lex_process_instance->source;
+}
+
+// 一次读过 len 个字节, 效果与调用 len 次 nextc 相同
+static void lex_skip(size_t len)
+{
+    lex_process_instance->function->skip(lex_process_instance, len);
 }
 
 static char assert_next_char(char c)
@@ -48,25 +122,46 @@ static char assert_next_char(char c)
     return next;
 }
 
-static pos lex_file_position()
+// 取出清空后的临时缓冲区, 每个 token 复用同一个缓冲区
+static struct buffer *lex_scratch_buffer()
+{
+    struct buffer *buffer = lex_process_instance->scratch_buffer;
+    buffer_clear(buffer);
+    return buffer;
+}
+
+// 驻留字符串, 返回其在驻留表中的编号
+static uint32_t lex_intern(const char *str, size_t len)
 {
-    return lex_process_instance->pos;
+    return intern_string_id(lex_process_instance->compiler->strings, str, len);
+}
+
+// 把数字放入字面量池, 返回其编号
+static uint32_t lex_literal(struct token_literal *literal)
+{
+    struct vector *literals = lex_process_instance->compiler->literals;
+    uint32_t id = vector_count(literals);
+    vector_push(literals, literal);
+    return id;
 }
 
 static token *lexer_last_token()
 {
-    return vector_back_or_null(lex_process_instance->token_vec);
+    return lex_process_instance->last_token;
 }
 
-// 处理空白字符
+// 处理空白字符, 一次跳过连续的空白
 static token *handle_whitespace()
 {
     token *last_token = lexer_last_token();
     if (last_token)
     {
-        last_token->whitespace = true;
+        last_token->flags |= TOKEN_FLAG_WHITESPACE;
+    }
+    while (LEX_CHAR_CLASS(peekc()) == CHAR_CLASS_WHITESPACE)
+    {
+        nextc();
     }
-    nextc();
     return read_next_token();
 }
 
@@ -74,204 +169,163 @@ token *
 token_create(token *_token)
 {
     memcpy(&tem_token, _token, sizeof(token));
-    tem_token.pos = lex_file_position();
+    tem_token.offset = token_start;
+    tem_token.length = lex_offset() - token_start;
+    tem_token.file_id = lex_process_instance->compiler->file_id;
     if (lex_is_in_expression())
     {
-        tem_token.between_brackets = buffer_ptr(lex_process_instance->parentheses_buffer);
+        tem_token.flags |= TOKEN_FLAG_IN_EXPRESSION;
     }
     return &tem_token;
 }
 
-const char *read_number_str()
-{
-    // const char *num = NULL;
-    struct buffer *buffer = buffer_create();
-    char c = peekc();
-    LEX_GETC_IF(buffer, c, (c >= '0' && c <= '9'));
-
-    buffer_write(buffer, 0x00);
-    return buffer_ptr(buffer);
-}
-
-unsigned long long read_number()
-{
-    const char *num_str = read_number_str();
-    return strtoull(num_str, NULL, 10);
-}
-
-int lexer_number_type(char c)
+// .5 这样以小数点开头的浮点数
+static bool lex_is_fraction_start()
 {
-    int res = NUMBER_TYPE_NORMAL;
-    if (c == 'L')
-    {
-        res = NUMBER_TYPE_LONG;
-    }
-    else if (c == 'f')
-    {
-        res = NUMBER_TYPE_FLOAT;
-    }
-    return res;
+    size_t len = 0;
+    const char *span = lex_span(&len);
+    return len >= 2 && span[0] == '.' && span[1] >= '0' && span[1] <= '9';
 }
 
-token *token_make_value_for_number(unsigned long number)
+// 生成数字 token, 直接在源码上解析
+token *token_make_number()
 {
-    int number_type = lexer_number_type(peekc());
-    if (number_type != NUMBER_TYPE_NORMAL)
+    size_t len = 0;
+    const char *span = lex_span(&len);
+    struct token_literal literal;
+    const char *error = NULL;
+    size_t number_len = lex_number_parse(span, len, &literal, &error);
+    if (error)
     {
-        nextc();
+        lex_error("%s\n", error);
     }
+    lex_skip(number_len);
     return token_create(&(token){
         .type = TOKEN_TYPE_NUMBER,
-        .llnum = number,
-        .num.type = number_type,
+        .literal_id = lex_literal(&literal),
     });
 }
 
-token *token_make_number()
-{
-    return token_make_value_for_number(read_number());
-}
-
 // 生成字符 token
 static token *token_make_string(char start_char, char end_char)
 {
-    struct buffer *buffer = buffer_create();
     assert(nextc() == start_char);
-    char c = nextc();
-    for (; c != end_char && c != EOF; c = nextc())
+    size_t len = 0;
+    const char *span = lex_span(&len);
+
+    // 按 "结束符或反斜杠" 分段扫描, 反斜杠本身不写入
+    struct buffer *buffer = lex_scratch_buffer();
+    size_t run_start = 0;
+    size_t i = lex_scan_until_either(span, len, end_char, '\\');
+    while (i < len && span[i] == '\\')
     {
-        if (c == '\\')
-        {
-            continue;
-        }
-        buffer_write(buffer, c);
+        buffer_write_bytes(buffer, span + run_start, i - run_start);
+        run_start = ++i;
+        i += lex_scan_until_either(span + i, len - i, end_char, '\\');
+    }
+
+    uint32_t str_id = 0;
+    if (run_start == 0)
+    {
+        // 没有反斜杠, 直接驻留输入中的这一段
+        str_id = lex_intern(span, i);
+    }
+    else
+    {
+        buffer_write_bytes(buffer, span + run_start, i - run_start);
+        str_id = lex_intern(buffer_ptr(buffer), buffer->len);
     }
-    buffer_write(buffer, 0x00);
+
+    lex_skip(i < len ? i + 1 : len);
     return token_create(&(token){
         .type = TOKEN_TYPE_STRING,
-        .sval = buffer_ptr(buffer),
+        .str_id = str_id,
     });
 }
 
-static bool op_treated_as_one(char op)
-{
-    return op == '(' || op == '[' || op == ',' || op == '.' || op == '*' || op == '?';
-}
-
-static bool is_single_operator(char op)
-{
-    return op == '+' || op == '-' || op == '*' || op == '/' || op == '%' || op == '=' || op == '!' || op == '>' || op == '<' || op == '&' || op == '|' || op == '^' || op == '?' || op == '(' || op == '[' || op == '.' || op == ',';
-}
-
-bool op_valid(const char *op)
-{
-    return S_EQ(op, "+") ||
-           S_EQ(op, "-") ||
-           S_EQ(op, "*") ||
-           S_EQ(op, "/") ||
-           S_EQ(op, "!") ||
-           S_EQ(op, "^") ||
-           S_EQ(op, "+=") ||
-           S_EQ(op, "-=") ||
-           S_EQ(op, "*=") ||
-           S_EQ(op, ">>=") ||
-           S_EQ(op, "<<=") ||
-           S_EQ(op, "/=") ||
-           S_EQ(op, ">>") ||
-           S_EQ(op, "<<") ||
-           S_EQ(op, ">=") ||
-           S_EQ(op, "<=") ||
-           S_EQ(op, ">") ||
-           S_EQ(op, "<") ||
-           S_EQ(op, "||") ||
-           S_EQ(op, "&&") ||
-           S_EQ(op, "|") ||
-           S_EQ(op, "&") ||
-           S_EQ(op, "++") ||
-           S_EQ(op, "--") ||
-           S_EQ(op, "=") ||
-           S_EQ(op, "*=") ||
-           S_EQ(op, "^=") ||
-           S_EQ(op, "==") ||
-           S_EQ(op, "!=") ||
-           S_EQ(op, "->") ||
-           S_EQ(op, "**") ||
-           S_EQ(op, "(") ||
-           S_EQ(op, "[") ||
-           S_EQ(op, ",") ||
-           S_EQ(op, ".") ||
-           S_EQ(op, "...") ||
-           S_EQ(op, "~") ||
-           S_EQ(op, "?") ||
-           S_EQ(op, "%");
-}
-
-void read_op_flush_back_keep_first(struct buffer *buffer)
-{
-    const char *data = buffer_ptr(buffer);
-    int len = buffer->len;
-    for (int i = len - 1; i >= 1; i--)
+// 下一个字符是 expected 时读入它
+static bool lex_accept(char expected)
+{
+    if (peekc() != expected)
     {
-        if (data[i] == 0x00)
-        {
-            continue;
-        }
-
-        pushc(data[i]);
+        return false;
     }
+
+    nextc();
+    return true;
 }
 
-const char *read_op()
+/**
+ * 直接编码的操作符 DFA, 按最长匹配读出一个操作符.
+ * 每个状态只向前看一个字符, 不需要回退.
+ */
+int read_op()
 {
-    bool single_operator = true;
     char op = nextc();
-    struct buffer *buffer = buffer_create();
-    buffer_write(buffer, op);
-
-    if (op_treated_as_one(op))
-    {
-        op = peekc();
-        if (is_single_operator(op))
-        {
-            buffer_write(buffer, op);
-            nextc();
-            single_operator = false;
-        }
-    }
-    buffer_write(buffer, 0x00);
-    char *ptr = buffer_ptr(buffer);
-    if (!single_operator)
-    {
-        if (!op_valid(ptr))
-        {
-            read_op_flush_back_keep_first(buffer);
-            ptr[1] = 0x00;
-        }
-    }
-
-    else if (!op_valid(ptr))
+    switch (op)
     {
-        compiler_error(lex_process_instance->compiler, "Unexpected operator %s\n", ptr);
+    case '+':
+        return lex_accept('+') ? OP_INCREMENT : lex_accept('=') ? OP_ADD_ASSIGN : OP_ADD;
+    case '-':
+        return lex_accept('-') ? OP_DECREMENT : lex_accept('=') ? OP_SUB_ASSIGN : lex_accept('>') ? OP_ARROW : OP_SUB;
+    case '*':
+        return lex_accept('*') ? OP_POW : lex_accept('=') ? OP_MUL_ASSIGN : OP_MUL;
+    case '/':
+        return lex_accept('=') ? OP_DIV_ASSIGN : OP_DIV;
+    case '%':
+        return lex_accept('=') ? OP_MOD_ASSIGN : OP_MOD;
+    case '!':
+        return lex_accept('=') ? OP_NE : OP_NOT;
+    case '^':
+        return lex_accept('=') ? OP_XOR_ASSIGN : OP_BITWISE_XOR;
+    case '=':
+        return lex_accept('=') ? OP_EQ : OP_ASSIGN;
+    case '|':
+        return lex_accept('|') ? OP_LOGICAL_OR : lex_accept('=') ? OP_OR_ASSIGN : OP_BITWISE_OR;
+    case '&':
+        return lex_accept('&') ? OP_LOGICAL_AND : lex_accept('=') ? OP_AND_ASSIGN : OP_BITWISE_AND;
+    case '<':
+        if (lex_accept('<'))
+            return lex_accept('=') ? OP_SHL_ASSIGN : OP_SHL;
+        return lex_accept('=') ? OP_LE : OP_LT;
+    case '>':
+        if (lex_accept('>'))
+            return lex_accept('=') ? OP_SHR_ASSIGN : OP_SHR;
+        return lex_accept('=') ? OP_GE : OP_GT;
+    case '.':
+        if (!lex_accept('.'))
+            return OP_DOT;
+        if (!lex_accept('.'))
+            lex_error("Unexpected operator ..\n");
+        return OP_ELLIPSIS;
+    case '~':
+        return OP_BITWISE_NOT;
+    case '(':
+        return OP_LPAREN;
+    case '[':
+        return OP_LBRACKET;
+    case ',':
+        return OP_COMMA;
+    case '?':
+        return OP_QUESTION;
     }
 
-    return ptr;
+    lex_error("Unexpected operator %c\n", op);
+    return OP_NONE;
 }
 
 static void lex_new_expression()
 {
     lex_process_instance->current_expression_count++;
-    if (lex_process_instance->current_expression_count == 1)
-    {
-        lex_process_instance->parentheses_buffer = buffer_create();
-    }
 }
 
 static void lex_end_expression()
 {
     lex_process_instance->current_expression_count--;
-    if (lex_process_instance->current_expression_count < 0)
+    // 从文件中间开始分析时不知道外层括号深度, 由拼接时统一检查
+    if (lex_process_instance->current_expression_count < 0 && !(lex_process_instance->flags & LEX_PROCESS_FLAG_CHUNK))
     {
-        compiler_error(lex_process_instance->compiler, "Unexpected ')'\n");
+        lex_error("Unexpected ')'\n");
     }
 }
 
@@ -280,25 +334,48 @@ bool lex_is_in_expression()
     return lex_process_instance->current_expression_count > 0;
 }
 
-// 生成操作符 token
+static token *token_make_one_line_comment();
+static token *token_make_multiline_comment();
+
+// 生成操作符 token, 以 '/' 开头的注释也在这里分派
 static token *token_make_operator_or_string()
 {
     char op = peekc();
     if (op == '<')
     {
         token *last_token = lexer_last_token();
-        if (token_is_keyword(last_token, "include"))
+        // #include <...> 中的头文件名按字符串读取
+        if (last_token && last_token->type == TOKEN_TYPE_IDENTIFIER && S_EQ(token_sval(lex_process_instance->compiler, last_token), "include"))
         {
             return token_make_string('<', '>');
         }
     }
+    else if (op == '/')
+    {
+        nextc();
+        if (lex_accept('/'))
+        {
+            return token_make_one_line_comment();
+        }
+        if (lex_accept('*'))
+        {
+            return token_make_multiline_comment();
+        }
+
+        int op_id = lex_accept('=') ? OP_DIV_ASSIGN : OP_DIV;
+        return token_create(&(token){
+            .type = TOKEN_TYPE_OPERATOR,
+            .op = op_id,
+        });
+    }
 
+    int op_id = read_op();
     token *token_instance = token_create(&(token){
         .type = TOKEN_TYPE_OPERATOR,
-        .sval = read_op(),
+        .op = op_id,
     });
 
-    if (op == '(')
+    if (op_id == OP_LPAREN)
     {
         lex_new_expression();
     }
@@ -322,95 +399,49 @@ static token *token_make_symbol()
     return token_instance;
 }
 
-bool keyword_is_datatype(const char *str)
-{
-    return S_EQ(str, "void") ||
-           S_EQ(str, "char") ||
-           S_EQ(str, "int") ||
-           S_EQ(str, "short") ||
-           S_EQ(str, "float") ||
-           S_EQ(str, "double") ||
-           S_EQ(str, "long") ||
-           S_EQ(str, "struct") ||
-           S_EQ(str, "union");
-}
-
-bool is_keyword(const char *keyword)
-{
-    return S_EQ(keyword, "if") ||
-           S_EQ(keyword, "else") ||
-           S_EQ(keyword, "while") ||
-           S_EQ(keyword, "for") ||
-           S_EQ(keyword, "do") ||
-           S_EQ(keyword, "switch") ||
-           S_EQ(keyword, "case") ||
-           S_EQ(keyword, "default") ||
-           S_EQ(keyword, "break") ||
-           S_EQ(keyword, "continue") ||
-           S_EQ(keyword, "return") ||
-           S_EQ(keyword, "goto") ||
-           S_EQ(keyword, "typedef") ||
-           S_EQ(keyword, "struct") ||
-           S_EQ(keyword, "union") ||
-           S_EQ(keyword, "enum") ||
-           S_EQ(keyword, "extern") ||
-           S_EQ(keyword, "static") ||
-           S_EQ(keyword, "const") ||
-           S_EQ(keyword, "volatile") ||
-           S_EQ(keyword, "register") ||
-           S_EQ(keyword, "auto") ||
-           S_EQ(keyword, "void") ||
-           S_EQ(keyword, "char") ||
-           S_EQ(keyword, "short") ||
-           S_EQ(keyword, "int") ||
-           S_EQ(keyword, "long") ||
-           S_EQ(keyword, "float") ||
-           S_EQ(keyword, "double") ||
-           S_EQ(keyword, "signed") ||
-           S_EQ(keyword, "unsigned") ||
-           S_EQ(keyword, "sizeof") ||
-           S_EQ(keyword, "typeof") ||
-           S_EQ(keyword, "bool") ||
-           S_EQ(keyword, "true") ||
-           S_EQ(keyword, "false") ||
-           S_EQ(keyword, "NULL");
+bool keyword_is_datatype(int keyword)
+{
+    switch (keyword)
+    {
+    case KEYWORD_VOID:
+    case KEYWORD_CHAR:
+    case KEYWORD_INT:
+    case KEYWORD_SHORT:
+    case KEYWORD_FLOAT:
+    case KEYWORD_DOUBLE:
+    case KEYWORD_LONG:
+    case KEYWORD_STRUCT:
+    case KEYWORD_UNION:
+        return true;
+    }
+    return false;
 }
 
 // 生成标识符 token
 static token *
 token_make_identifier_or_keyword()
 {
-    struct buffer *buffer = buffer_create();
-    char c = 0;
-    LEX_GETC_IF(buffer, c, (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (c >= '0' && c <= '9'));
-
-    buffer_write(buffer, 0x00);
-
-    if (is_keyword(buffer_ptr(buffer)))
+    size_t len = 0;
+    const char *span = lex_span(&len);
+    size_t identifier_len = lex_scan_identifier(span, len);
+    int keyword = keyword_lookup(span, identifier_len);
+    if (keyword != KEYWORD_NONE)
     {
+        lex_skip(identifier_len);
         return token_create(&(token){
             .type = TOKEN_TYPE_KEYWORD,
-            .sval = buffer_ptr(buffer),
+            .keyword = keyword,
         });
     }
 
+    uint32_t str_id = lex_intern(span, identifier_len);
+    lex_skip(identifier_len);
     return token_create(&(token){
         .type = TOKEN_TYPE_IDENTIFIER,
-        .sval = buffer_ptr(buffer),
+        .str_id = str_id,
     });
 }
 
-token *read_special_token()
-{
-    char c = peekc();
-    if (isalpha(c) || c == '_')
-    {
-        return token_make_identifier_or_keyword();
-    }
-
-    return NULL;
-}
-
 // 生成换行符 token
 static token *token_make_newline()
 {
@@ -423,67 +454,37 @@ static token *token_make_newline()
 // 单行注释
 static token *token_make_one_line_comment()
 {
-    struct buffer *buffer = buffer_create();
-    char c = 0;
-    LEX_GETC_IF(buffer, c, c != '\n' && c != EOF);
+    size_t len = 0;
+    const char *span = lex_span(&len);
+    size_t comment_len = lex_scan_until_char(span, len, '\n');
+    uint32_t str_id = lex_intern(span, comment_len);
+    lex_skip(comment_len);
     return token_create(&(token){
         .type = TOKEN_TYPE_COMMENT,
-        .sval = buffer_ptr(buffer),
+        .str_id = str_id,
     });
 }
 
 // 多行注释
 static token *token_make_multiline_comment()
 {
-    struct buffer *buffer = buffer_create();
-    char c = 0;
-    while (1)
+    size_t len = 0;
+    const char *span = lex_span(&len);
+    size_t comment_len = lex_scan_comment_end(span, len);
+    if (comment_len == len)
     {
-        LEX_GETC_IF(buffer, c, c != '*' && c != EOF);
-        if (c == EOF)
-        {
-            compiler_error(lex_process_instance->compiler, "你没有关闭多行注释\n");
-        }
-        if (c == '*')
-        {
-            nextc();
-            if (peekc() == '/')
-            {
-                nextc();
-                break;
-            }
-        }
+        lex_error("你没有关闭多行注释\n");
     }
 
+    uint32_t str_id = lex_intern(span, comment_len);
+    // 连同结尾的 "*/" 一起读过
+    lex_skip(comment_len + 2);
     return token_create(&(token){
         .type = TOKEN_TYPE_COMMENT,
-        .sval = buffer_ptr(buffer),
+        .str_id = str_id,
     });
 }
 
-static token *handle_comment()
-{
-    char c = peekc();
-    if (c == '/')
-    {
-        nextc();
-        if (peekc() == '/')
-        {
-            nextc();
-            return token_make_one_line_comment();
-        }
-        else if (peekc() == '*')
-        {
-            nextc();
-            return token_make_multiline_comment();
-        }
-
-        pushc('/');
-        return token_make_operator_or_string();
-    }
-    return NULL;
-}
-
 char lex_get_escaped_char(char c)
 {
     char escaped_char = 0;
@@ -517,58 +518,55 @@ token *token_make_quote()
 
     if (nextc() != '\'')
     {
-        compiler_error(lex_process_instance->compiler, "你没有正确关闭单引号\n");
+        lex_error("你没有正确关闭单引号\n");
     }
     return token_create(&(token){
         .type = TOKEN_TYPE_NUMBER,
-        .cval = c,
+        .literal_id = lex_literal(&(struct token_literal){.type = NUMBER_TYPE_NORMAL, .llnum = c}),
     });
 }
 
 token *read_next_token()
 {
     token *token_instance = NULL;
-    char c = peekc();
-
-    token_instance = handle_comment();
-    if (token_instance)
+    token_start = lex_offset();
+    if (token_start >= lex_process_instance->limit)
     {
-        return token_instance;
+        return NULL;
     }
-    switch (c)
+    char c = peekc();
+    switch (LEX_CHAR_CLASS(c))
     {
-    NUMERIC_CASES:
+    case CHAR_CLASS_DIGIT:
         token_instance = token_make_number();
         break;
-    OPERATOR_CASES_EXCLUDING_DIVISION:
-        token_instance = token_make_operator_or_string();
+    case CHAR_CLASS_IDENTIFIER:
+        token_instance = token_make_identifier_or_keyword();
         break;
-    SYMBOL_CASE:
+    case CHAR_CLASS_OPERATOR:
+        token_instance = lex_is_fraction_start() ? token_make_number() : token_make_operator_or_string();
+        break;
+    case CHAR_CLASS_SYMBOL:
         token_instance = token_make_symbol();
         break;
-    case ' ':
-    case '\t':
+    case CHAR_CLASS_WHITESPACE:
         token_instance = handle_whitespace();
         break;
-    case '"': // 字符串
+    case CHAR_CLASS_STRING: // 字符串
         token_instance = token_make_string('"', '"');
         break;
-    case '\'': // 字符
+    case CHAR_CLASS_QUOTE: // 字符
         token_instance = token_make_quote();
         break;
-    case '\n':
+    case CHAR_CLASS_NEWLINE:
         token_instance = token_make_newline();
         break;
-    case EOF:
+    case CHAR_CLASS_EOF:
         // 读到文件尾部
         break;
 
     default:
-        token_instance = read_special_token();
-        if (!token_instance)
-        {
-            compiler_error(lex_process_instance->compiler, "Unexpected token\n");
-        }
+        lex_error("Unexpected token\n");
     }
 
     return token_instance;
@@ -608,10 +606,10 @@ void print_token_type(int type)
     }
 }
 
-void print_token_vec(struct vector *token_vec)
+void print_token_vec(compile_process *compiler, VEC(token) *token_vec)
 {
-    vector_set_peek_pointer(token_vec, 0);
-    token *token_instance = (struct token *)vector_peek(token_vec);
+    vector_set_peek_pointer(&token_vec->base, 0);
+    token *token_instance = vec_token_peek(token_vec);
     while (token_instance)
     {
         print_token_type(token_instance->type);
@@ -619,14 +617,24 @@ void print_token_vec(struct vector *token_vec)
         switch (token_instance->type)
         {
         case TOKEN_TYPE_NUMBER:
-            printf("%llu", token_instance->llnum);
+        {
+            struct token_literal *literal = token_literal(compiler, token_instance);
+            if (literal->type == NUMBER_TYPE_FLOAT || literal->type == NUMBER_TYPE_DOUBLE)
+            {
+                printf("%.17g", literal->dval);
+            }
+            else
+            {
+                printf("%llu", literal->llnum);
+            }
             break;
+        }
         case TOKEN_TYPE_STRING:
         case TOKEN_TYPE_IDENTIFIER:
         case TOKEN_TYPE_KEYWORD:
         case TOKEN_TYPE_OPERATOR:
         case TOKEN_TYPE_COMMENT:
-            printf("'%s'", token_instance->sval);
+            printf("'%s'", token_sval(compiler, token_instance));
             break;
         case TOKEN_TYPE_SYMBOL:
             printf("'%c'", token_instance->cval);
@@ -637,20 +645,45 @@ void print_token_vec(struct vector *token_vec)
         default:
             printf("Unknown");
         }
-        printf(", Position: Line %d, Column %d", token_instance->pos.line, token_instance->pos.col);
+        pos token_pos = token_position(compiler, token_instance);
+        printf(", Position: Line %d, Column %d", token_pos.line, token_pos.col);
         printf("\n");
-        token_instance = vector_peek(token_vec);
+        token_instance = vec_token_peek(token_vec);
     }
 }
 
-int lex(lex_process *process)
+void lex_begin(lex_process *process)
 {
     process->current_expression_count = 0;
-    process->parentheses_buffer = NULL;
+    process->last_token = NULL;
     lex_process_instance = process;
-    process->pos.filename = process->compiler->input_file->abs_path;
+    size_t len = 0;
+    process->source = lex_span(&len);
+    // 从字符串读取时没有对应的文件位置
+    cfile *input = process->compiler->input_file;
+    bool in_file = process->source >= input->data && process->source <= input->end;
+    process->base = in_file ? (size_t)(process->source - input->data) : 0;
+}
+
+// 读出下一个 token, 文件结束时返回 NULL; 返回的 token 在下次调用前有效
+token *lex_next_token(lex_process *process)
+{
+    lex_process_instance = process;
+    return read_next_token();
+}
+
+int lex(lex_process *process)
+{
+    lex_begin(process);
+
+    // 按源码大小预估 token 数, 避免 token 向量反复扩容
+    cfile *input = process->compiler->input_file;
+    if (process->source >= input->data && process->source < input->end)
+    {
+        vector_reserve(&process->token_vec->base, vec_token_count(process->token_vec) + (input->end - process->source) / LEX_BYTES_PER_TOKEN);
+    }
 
-    token *token_instance = read_next_token();
+    token *token_instance = lex_next_token(process);
     while (token_instance)
     {
         // if (token_instance->type == TOKEN_TYPE_NUMBER)
@@ -658,10 +691,11 @@ int lex(lex_process *process)
         //     printf("%llu", token_instance->llnum);
         // }
 
-        vector_push(process->token_vec, token_instance);
-        token_instance = read_next_token();
+        vec_token_push(process->token_vec, *token_instance);
+        process->last_token = vec_token_back(process->token_vec);
+        token_instance = lex_next_token(process);
     }
-    print_token_vec(process->token_vec);
+    print_token_vec(process->compiler, process->token_vec);
 
     return LEXICAL_ANALYSIS_ALL_OK;
 }
@@ -684,16 +718,31 @@ void lexer_string_buffer_push_char(lex_process *process, char c)
     buffer_write(buffer, c);
 }
 
+const char *lexer_string_buffer_peek_span(lex_process *process, size_t *len)
+{
+    struct buffer *buffer = lex_process_private(process);
+    *len = buffer->len - buffer->rindex;
+    return (const char *)buffer_ptr(buffer) + buffer->rindex;
+}
+
+void lexer_string_buffer_skip(lex_process *process, size_t len)
+{
+    struct buffer *buffer = lex_process_private(process);
+    buffer->rindex += len;
+}
+
 lex_process_functions lexer_string_buffer_functions = {
     .next_char = lexer_string_buffer_next_char,
     .peek_char = lexer_string_buffer_peek_char,
     .push_char = lexer_string_buffer_push_char,
+    .peek_span = lexer_string_buffer_peek_span,
+    .skip = lexer_string_buffer_skip,
 };
 
 lex_process *token_build_for_string(compile_process *compiler, const char *str)
 {
     struct buffer *buffer = buffer_create();
-    buffer_printf(buffer, str);
+    buffer_write_str(buffer, str);
     lex_process *process = lex_process_create(compiler, &lexer_string_buffer_functions, buffer);
     if (!lex_process_instance)
         return NULL;
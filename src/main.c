@@ -4,7 +4,7 @@
 
 int main()
 {
-    int res = compile_file("tests/test.cmm", "tests/test.s", OUTPUT_TYPE_ASSEMBLY);
+    int res = compile_file("tests/test.cmm", "tests/test.s", OUTPUT_TYPE_ASSEMBLY, 0);
     if (res == FAILURE)
         printf("Compilation failed.\n");
     else if (res == SUCCESS)
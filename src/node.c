@@ -2,42 +2,51 @@
 #include "../helpers/vector.h"
 #include <assert.h>
 
-struct vector *node_vector = NULL;
-struct vector *node_vector_root = NULL;
+VEC(node_ptr) *node_vector = NULL;
+VEC(node_ptr) *node_vector_root = NULL;
+// 节点按语法分析的顺序从编译进程的 arena 中连续分配
+struct arena *node_arena = NULL;
 
 struct node *parser_current_body = NULL;
 
-void node_set_vector(struct vector *vec, struct vector *root_vec)
+void node_set_vector(VEC(node_ptr) *vec, VEC(node_ptr) *root_vec)
 {
     node_vector = vec;
     node_vector_root = root_vec;
 }
 
+void node_set_arena(struct arena *arena)
+{
+    node_arena = arena;
+}
+
 void node_push(struct node *node)
 {
-    vector_push(node_vector, &node);
+    vec_node_ptr_push(node_vector, node);
 }
 
 struct node *node_peek_or_null()
 {
-    return vector_back_ptr_or_null(node_vector);
+    struct node **last = vec_node_ptr_back_or_null(node_vector);
+    return last ? *last : NULL;
 }
 
 struct node *node_peek()
 {
-    return *(struct node **)vector_back(node_vector);
+    return *vec_node_ptr_back(node_vector);
 }
 
 struct node *node_pop()
 {
-    struct node *last_node = vector_back_ptr(node_vector);
-    struct node *last_node_root = vector_empty(node_vector) ? NULL : vector_back_ptr_or_null(node_vector_root);
+    struct node *last_node = *vec_node_ptr_back(node_vector);
+    struct node **last_root = vec_node_ptr_back_or_null(node_vector_root);
+    struct node *last_node_root = last_root ? *last_root : NULL;
 
-    vector_pop(node_vector);
+    vector_pop(&node_vector->base);
 
     if (last_node == last_node_root)
     {
-        vector_pop(node_vector_root);
+        vector_pop(&node_vector_root->base);
     }
 
     return last_node;
@@ -54,21 +63,21 @@ struct node *node_peek_expressionable_or_null()
     return node_is_expressionable(last_node) ? last_node : NULL;
 }
 
-void make_exp_node(struct node *left_node, struct node *right_node, const char *op)
+void make_exp_node(struct node *left_node, struct node *right_node, int op)
 {
     assert(left_node);
     assert(right_node);
     node_create(&(struct node){.type = NODE_TYPE_EXPRESSION, .exp.left = left_node, .exp.right = right_node, .exp.op = op});
 }
 
-void make_body_node(struct vector *body_vec, size_t size, bool padded, struct node *largest_var_node)
+void make_body_node(VEC(node_ptr) *body_vec, size_t size, bool padded, struct node *largest_var_node)
 {
     node_create(&(struct node){NODE_TYPE_BODY, .body.statements = body_vec, .body.size = size, .body.padded = padded, .body.largest_var_node = largest_var_node});
 }
 
 struct node *node_create(struct node *node)
 {
-    struct node *new_node = (struct node *)malloc(sizeof(struct node));
+    struct node *new_node = (struct node *)arena_alloc(node_arena, sizeof(struct node));
     memcpy(new_node, node, sizeof(struct node));
     node_push(new_node);
     return new_node;
@@ -0,0 +1,20 @@
+#include "compiler.h"
+
+static const char *operator_names[OP_TOTAL] = {
+    [OP_NONE] = NULL,
+#define OPERATOR(name, str) [OP_##name] = str,
+#define OPERATOR_NODE(name, str) [OP_##name] = str,
+#include "operators.def"
+#undef OPERATOR
+#undef OPERATOR_NODE
+};
+
+const char *operator_str(int op)
+{
+    if (op <= OP_NONE || op >= OP_TOTAL)
+    {
+        return NULL;
+    }
+
+    return operator_names[op];
+}
@@ -13,8 +13,6 @@ extern struct node *parser_current_body;
 int parse_expressionable_single(struct history *history);
 void parse_expressionable(struct history *history);
 
-extern struct expressionable_op_precedence_group op_precedence[TOTAL_OPERATOR_GROUPS];
-
 static compile_process *current_process;
 static struct token *parser_last_token;
 static bool token_is_nl_or_comment_or_newline_seperator(struct token *token);
@@ -35,25 +33,44 @@ static bool token_is_nl_or_comment_or_newline_seperator(struct token *token)
 
 struct history *history_begin(int flags)
 {
-    struct history *history = (struct history *)malloc(sizeof(struct history));
+    struct history *history = (struct history *)arena_alloc(current_process->arena, sizeof(struct history));
     history->flags = flags;
     return history;
 }
 
 struct history *history_down(struct history *history, int flags)
 {
-    struct history *new_history = (struct history *)malloc(sizeof(struct history));
+    struct history *new_history = (struct history *)arena_alloc(current_process->arena, sizeof(struct history));
     memcpy(new_history, history, sizeof(struct history));
     new_history->flags = flags;
     return new_history;
 }
 
+// 流式模式下从 token_stream 读取, 否则读取完整的 token 向量
+static struct token *parser_peek_token()
+{
+    if (current_process->token_stream)
+    {
+        return token_stream_peek(current_process->token_stream);
+    }
+    return vec_token_peek_no_increment(current_process->token_vec);
+}
+
+static struct token *parser_pop_token()
+{
+    if (current_process->token_stream)
+    {
+        return token_stream_next(current_process->token_stream);
+    }
+    return vec_token_peek(current_process->token_vec);
+}
+
 static void parser_ignore_nl_or_comment(struct token *token)
 {
     while (token && token_is_nl_or_comment_or_newline_seperator(token))
     {
-        vector_peek(current_process->token_vec);
-        token = vector_peek_no_increment(current_process->token_vec);
+        parser_pop_token();
+        token = parser_peek_token();
     }
 }
 
@@ -69,18 +86,21 @@ void parser_scope_finish()
 
 static struct token *token_next()
 {
-    struct token *next_token = vector_peek_no_increment(current_process->token_vec);
-    parser_ignore_nl_or_comment(next_token);
-    current_process->pos = next_token->pos;
+    parser_ignore_nl_or_comment(parser_peek_token());
+    struct token *next_token = parser_pop_token();
+    if (next_token)
+    {
+        current_process->offset = next_token->offset;
+        current_process->file_id = next_token->file_id;
+    }
     parser_last_token = next_token;
-    return vector_peek(current_process->token_vec);
+    return next_token;
 }
 
 static token *token_peek_next()
 {
-    struct token *next_token = vector_peek_no_increment(current_process->token_vec);
-    parser_ignore_nl_or_comment(next_token);
-    return vector_peek_no_increment(current_process->token_vec);
+    parser_ignore_nl_or_comment(parser_peek_token());
+    return parser_peek_token();
 }
 
 static void expect_sym(char c)
@@ -92,14 +112,14 @@ static void expect_sym(char c)
     }
 }
 
-static void expect_op(const char *op)
+static void expect_op(int op)
 {
     struct token *next_token = token_next();
-    if (next_token == NULL || next_token->type != TOKEN_TYPE_OPERATOR || !S_EQ(next_token->sval, op))
-        compiler_error(current_process, "Expecting the operator %s but something else was provided", op);
+    if (!token_is_operator(next_token, op))
+        compiler_error(current_process, "Expecting the operator %s but something else was provided", operator_str(op));
 }
 
-static bool token_next_is_operator(const char *op)
+static bool token_next_is_operator(int op)
 {
     struct token *token = token_peek_next();
     return token_is_operator(token, op);
@@ -118,15 +138,25 @@ void parse_single_token_to_node()
     switch (token->type)
     {
     case TOKEN_TYPE_NUMBER:
-        node = node_create(&(struct node){.type = NODE_TYPE_NUMBER, .llnum = token->llnum});
+    {
+        struct token_literal *literal = token_literal(current_process, token);
+        if (literal->type == NUMBER_TYPE_FLOAT || literal->type == NUMBER_TYPE_DOUBLE)
+        {
+            node = node_create(&(struct node){.type = NODE_TYPE_NUMBER, .dval = literal->dval});
+        }
+        else
+        {
+            node = node_create(&(struct node){.type = NODE_TYPE_NUMBER, .llnum = literal->llnum});
+        }
         break;
+    }
 
     case TOKEN_TYPE_IDENTIFIER:
-        node = node_create(&(struct node){.type = NODE_TYPE_IDENTIFIER, .sval = token->sval});
+        node = node_create(&(struct node){.type = NODE_TYPE_IDENTIFIER, .sval = token_sval(current_process, token)});
         break;
 
     case TOKEN_TYPE_STRING:
-        node = node_create(&(struct node){.type = NODE_TYPE_STRING, .sval = token->sval});
+        node = node_create(&(struct node){.type = NODE_TYPE_STRING, .sval = token_sval(current_process, token)});
         break;
 
     default:
@@ -134,46 +164,25 @@ void parse_single_token_to_node()
     }
 }
 
-void parse_expressionable_for_op(struct history *history, const char *op)
+void parse_expressionable_for_op(struct history *history, int op)
 {
     parse_expressionable(history);
 }
 
-static int parser_get_precedence_for_operator(const char *op, struct expressionable_op_precedence_group **group_out)
-{
-    *group_out = NULL;
-    for (int i = 0; i < TOTAL_OPERATOR_GROUPS; i++)
-    {
-        for (int b = 0; op_precedence[i].operators[b]; b++)
-        {
-            const char *_op = op_precedence[i].operators[b];
-            if (S_EQ(op, _op))
-            {
-
-                *group_out = &op_precedence[i];
-                return i;
-            }
-        }
-    }
-}
-
-static bool parser_left_op_has_priority(const char *op_left, const char *op_right)
+static bool parser_left_op_has_priority(int op_left, int op_right)
 {
-    struct expressionable_op_precedence_group *group_left = NULL;
-    struct expressionable_op_precedence_group *group_right = NULL;
-
     // Same operator? Then they have equal priority!
-    if (S_EQ(op_left, op_right))
+    if (op_left == op_right)
         return false;
 
-    int precedence_left = parser_get_precedence_for_operator(op_left, &group_left);
-    int precedence_right = parser_get_precedence_for_operator(op_right, &group_right);
+    const struct expressionable_op_precedence_group *group_left = &op_precedence[op_left];
+    const struct expressionable_op_precedence_group *group_right = &op_precedence[op_right];
     if (group_left->associativity == ASSOCIATIVITY_RIGHT_TO_LEFT)
     {
         return false;
     }
 
-    return precedence_left <= precedence_right;
+    return group_left->precedence <= group_right->precedence;
 }
 
 void parser_node_shift_children_left(struct node *node)
@@ -181,7 +190,7 @@ void parser_node_shift_children_left(struct node *node)
     assert(node->type == NODE_TYPE_EXPRESSION);
     assert(node->exp.right->type == NODE_TYPE_EXPRESSION);
 
-    const char *right_op = node->exp.right->exp.op;
+    int right_op = node->exp.right->exp.op;
     struct node *new_exp_left_node = node->exp.left;
     struct node *new_exp_right_node = node->exp.right->exp.left;
     make_exp_node(new_exp_left_node, new_exp_right_node, node->exp.op);
@@ -208,7 +217,7 @@ void parser_reorder_expression(struct node **node_out)
 
     if (node->exp.left->type != NODE_TYPE_EXPRESSION && node->exp.right && node->exp.right->type == NODE_TYPE_EXPRESSION)
     {
-        const char *op = node->exp.right->exp.op;
+        int op = node->exp.right->exp.op;
         if (parser_left_op_has_priority(node->exp.op, op))
         {
             parser_node_shift_children_left(node);
@@ -222,7 +231,7 @@ void parser_reorder_expression(struct node **node_out)
 void parse_expression_normal(struct history *history)
 {
     struct token *token = token_peek_next();
-    const char *op = token->sval;
+    int op = token->op;
     struct node *node_left = node_peek_expressionable_or_null();
     if (!node_left)
     {
@@ -259,14 +268,18 @@ void parse_identifier(struct history *history)
     parse_single_token_to_node();
 }
 
-static bool is_keyword_variable_modifier(const char *val)
+static bool is_keyword_variable_modifier(int keyword)
 {
-    return S_EQ(val, "unsigned") ||
-           S_EQ(val, "signed") ||
-           S_EQ(val, "static") ||
-           S_EQ(val, "const") ||
-           S_EQ(val, "extern") ||
-           S_EQ(val, "__ignore_typecheck__");
+    switch (keyword)
+    {
+    case KEYWORD_UNSIGNED:
+    case KEYWORD_SIGNED:
+    case KEYWORD_STATIC:
+    case KEYWORD_CONST:
+    case KEYWORD_EXTERN:
+        return true;
+    }
+    return false;
 }
 
 void parse_datatype_modifiers(struct datatype *dtype)
@@ -274,34 +287,28 @@ void parse_datatype_modifiers(struct datatype *dtype)
     struct token *token = token_peek_next();
     while (token && token->type == TOKEN_TYPE_KEYWORD)
     {
-        if (!is_keyword_variable_modifier(token->sval))
+        if (!is_keyword_variable_modifier(token->keyword))
         {
             break;
         }
 
-        if (S_EQ(token->sval, "signed"))
+        switch (token->keyword)
         {
+        case KEYWORD_SIGNED:
             dtype->flags |= DATATYPE_FLAG_IS_SIGNED;
-        }
-        else if (S_EQ(token->sval, "unsigned"))
-        {
+            break;
+        case KEYWORD_UNSIGNED:
             dtype->flags &= ~DATATYPE_FLAG_IS_SIGNED;
-        }
-        else if (S_EQ(token->sval, "static"))
-        {
+            break;
+        case KEYWORD_STATIC:
             dtype->flags |= DATATYPE_FLAG_IS_STATIC;
-        }
-        else if (S_EQ(token->sval, "const"))
-        {
+            break;
+        case KEYWORD_CONST:
             dtype->flags |= DATATYPE_FLAG_IS_CONST;
-        }
-        else if (S_EQ(token->sval, "extern"))
-        {
+            break;
+        case KEYWORD_EXTERN:
             dtype->flags |= DATATYPE_FLAG_IS_EXTERN;
-        }
-        else if (S_EQ(token->sval, "__ignore_typecheck__"))
-        {
-            dtype->flags |= DATATYPE_FLAG_IGNORE_TYPE_CHECKING;
+            break;
         }
 
         token_next();
@@ -320,14 +327,14 @@ void parser_get_datatype_tokens(struct token **datatype_token, struct token **da
     }
 }
 
-int parser_datatype_expected_for_type_string(const char *str)
+int parser_datatype_expected_for_keyword(int keyword)
 {
     int type = DATA_TYPE_EXPECT_PRIMITIVE;
-    if (S_EQ(str, "union"))
+    if (keyword == KEYWORD_UNION)
     {
         type = DATA_TYPE_EXPECT_UNION;
     }
-    else if (S_EQ(str, "struct"))
+    else if (keyword == KEYWORD_STRUCT)
     {
         type = DATA_TYPE_EXPECT_STRUCT;
     }
@@ -339,18 +346,16 @@ token *parser_build_random_type_name()
 {
     char tmp_name[32];
     sprintf(tmp_name, "__%d", rand());
-    char *sval = malloc(sizeof(tmp_name));
-    strncpy(sval, tmp_name, sizeof(tmp_name));
-    token *token = calloc(1, sizeof(token));
+    token *token = arena_calloc(current_process->arena, sizeof(struct token));
     token->type = TOKEN_TYPE_IDENTIFIER;
-    token->sval = sval;
+    token->str_id = intern_string_id(current_process->strings, tmp_name, strlen(tmp_name));
     return token;
 }
 
 int parser_get_pointer_depth()
 {
     int depth = 0;
-    while (token_next_is_operator("*"))
+    while (token_next_is_operator(OP_MUL))
     {
         depth++;
         token_next();
@@ -363,9 +368,9 @@ bool parser_datatype_is_secondary_allowed(int expected_type)
     return expected_type == DATA_TYPE_EXPECT_PRIMITIVE;
 }
 
-bool parser_datatype_is_secondary_allowed_for_type(const char *type)
+bool parser_datatype_is_secondary_allowed_for_type(int keyword)
 {
-    return S_EQ(type, "long") || S_EQ(type, "short") || S_EQ(type, "double") || S_EQ(type, "float");
+    return keyword == KEYWORD_LONG || keyword == KEYWORD_SHORT || keyword == KEYWORD_DOUBLE || keyword == KEYWORD_FLOAT;
 }
 
 void parser_datatype_adjust_size_for_secondary(struct datatype *datatype, struct token *datatype_secondary_token)
@@ -375,7 +380,7 @@ void parser_datatype_adjust_size_for_secondary(struct datatype *datatype, struct
         return;
     }
 
-    struct datatype *secondary_data_type = calloc(sizeof(struct datatype), 1);
+    struct datatype *secondary_data_type = arena_calloc(current_process->arena, sizeof(struct datatype));
     parser_datatype_init_type_and_size_for_primitive(datatype_secondary_token, NULL, secondary_data_type);
     datatype->size += secondary_data_type->size;
     datatype->secondary = secondary_data_type;
@@ -384,50 +389,44 @@ void parser_datatype_adjust_size_for_secondary(struct datatype *datatype, struct
 
 void parser_datatype_init_type_and_size_for_primitive(struct token *datatype_token, struct token *datatype_secondary_token, struct datatype *datatype_out)
 {
-    if (!parser_datatype_is_secondary_allowed_for_type(datatype_token->sval) && datatype_secondary_token)
+    if (!parser_datatype_is_secondary_allowed_for_type(token_keyword(datatype_token)) && datatype_secondary_token)
     {
         // no secondary is allowed
-        compiler_error(current_process, "Your not allowed a secondary datatype here for the given datatype %s", datatype_token->sval);
+        compiler_error(current_process, "Your not allowed a secondary datatype here for the given datatype %s", token_sval(current_process, datatype_token));
     }
 
-    if (S_EQ(datatype_token->sval, "void"))
+    switch (token_keyword(datatype_token))
     {
+    case KEYWORD_VOID:
         datatype_out->type = DATA_TYPE_VOID;
         datatype_out->size = 0;
-    }
-    else if (S_EQ(datatype_token->sval, "char"))
-    {
+        break;
+    case KEYWORD_CHAR:
         datatype_out->type = DATA_TYPE_CHAR;
         datatype_out->size = 1;
-    }
-    else if (S_EQ(datatype_token->sval, "short"))
-    {
+        break;
+    case KEYWORD_SHORT:
         datatype_out->type = DATA_TYPE_SHORT;
         datatype_out->size = 2;
-    }
-    else if (S_EQ(datatype_token->sval, "int"))
-    {
+        break;
+    case KEYWORD_INT:
         datatype_out->type = DATA_TYPE_INTEGER;
         datatype_out->size = 4;
-    }
-    else if (S_EQ(datatype_token->sval, "long"))
-    {
+        break;
+    case KEYWORD_LONG:
         // We are a 32 bit compiler so long is 4 bytes.
         datatype_out->type = DATA_TYPE_LONG;
         datatype_out->size = 4;
-    }
-    else if (S_EQ(datatype_token->sval, "float"))
-    {
+        break;
+    case KEYWORD_FLOAT:
         datatype_out->type = DATA_TYPE_FLOAT;
         datatype_out->size = 4;
-    }
-    else if (S_EQ(datatype_token->sval, "double"))
-    {
+        break;
+    case KEYWORD_DOUBLE:
         datatype_out->type = DATA_TYPE_DOUBLE;
         datatype_out->size = 4;
-    }
-    else
-    {
+        break;
+    default:
         compiler_error(current_process, "Bug unexpected primitive variable\n");
     }
 
@@ -466,9 +465,9 @@ void parser_datatype_init_type_and_size(struct token *datatype_token, struct tok
 void parser_datatype_init(struct token *datatype_token, struct token *datatype_secondary_token, struct datatype *datatype_out, int pointer_depth, int expected_type)
 {
     parser_datatype_init_type_and_size(datatype_token, datatype_secondary_token, datatype_out, pointer_depth, expected_type);
-    datatype_out->type_str = datatype_token->sval;
+    datatype_out->type_str = token_sval(current_process, datatype_token);
 
-    if (S_EQ(datatype_token->sval, "long") && datatype_secondary_token && S_EQ(datatype_secondary_token->sval, "long"))
+    if (token_is_keyword_id(datatype_token, KEYWORD_LONG) && token_is_keyword_id(datatype_secondary_token, KEYWORD_LONG))
     {
         compiler_warning(current_process, "Our compiler does not support 64 bit long long so it will be treated as a 32 bit type not 64 bit\n");
         datatype_out->size = DATA_SIZE_DWORD;
@@ -480,8 +479,8 @@ void parse_datatype_type(struct datatype *dtype)
     token *datatype_token = NULL;
     token *datatype_secondary_token = NULL;
     parser_get_datatype_tokens(&datatype_token, &datatype_secondary_token);
-    int expected_type = parser_datatype_expected_for_type_string(datatype_token->sval);
-    if (datatype_is_struct_or_union_for_name(datatype_token->sval))
+    int expected_type = parser_datatype_expected_for_keyword(token_keyword(datatype_token));
+    if (expected_type != DATA_TYPE_EXPECT_PRIMITIVE)
     {
         if (token_peek_next()->type == TOKEN_TYPE_IDENTIFIER)
         {
@@ -495,8 +494,17 @@ void parse_datatype_type(struct datatype *dtype)
         }
     }
 
+    // 流式模式下读过的 token 会被覆盖, 读取指针层数前先复制
+    struct token datatype_token_copy = *datatype_token;
+    struct token datatype_secondary_token_copy;
+    if (datatype_secondary_token)
+    {
+        datatype_secondary_token_copy = *datatype_secondary_token;
+        datatype_secondary_token = &datatype_secondary_token_copy;
+    }
+
     int pointer_depth = parser_get_pointer_depth();
-    parser_datatype_init(datatype_token, datatype_secondary_token, dtype, pointer_depth, expected_type);
+    parser_datatype_init(&datatype_token_copy, datatype_secondary_token, dtype, pointer_depth, expected_type);
 }
 void parse_datatype(struct datatype *dtype)
 {
@@ -520,7 +528,7 @@ void make_variable_node(struct datatype *dtype, struct token *name_token, struct
     const char *name_str = NULL;
     if (name_token)
     {
-        name_str = name_token->sval;
+        name_str = token_sval(current_process, name_token);
     }
 
     node_create(&(struct node){.type = NODE_TYPE_VARIABLE, .var.type = *dtype, .var.name = name_str, .var.val = value_node});
@@ -545,15 +553,17 @@ void make_variable_list_node(struct vector *var_list_vec)
 
 void parse_variable(struct datatype *dtype, struct token *name_token, struct history *history)
 {
+    // 解析初值会读过任意多 token, 先保留名字 token 的副本
+    struct token name = *name_token;
     struct node *value_node = NULL;
-    if (token_next_is_operator("="))
+    if (token_next_is_operator(OP_ASSIGN))
     {
         token_next();
         parse_expressionable_root(history);
         value_node = node_pop();
     }
 
-    make_variable_node_and_register(history, dtype, name_token, value_node);
+    make_variable_node_and_register(history, dtype, &name, value_node);
 }
 
 void parse_variable_function_or_struct_union(struct history *history)
@@ -572,12 +582,12 @@ void parse_variable_function_or_struct_union(struct history *history)
     }
 
     parse_variable(&dtype, name_token, history);
-    if (token_is_operator(token_peek_next(), ","))
+    if (token_is_operator(token_peek_next(), OP_COMMA))
     {
         struct vector *var_list = vector_create(sizeof(struct node *));
         struct node *var_node = node_pop();
         vector_push(var_list, &var_node);
-        while (token_is_operator(token_peek_next(), ","))
+        while (token_is_operator(token_peek_next(), OP_COMMA))
         {
             token_next();
             name_token = token_next();
@@ -599,7 +609,7 @@ bool parser_is_int_valid_after_datatype(struct datatype *dtype)
 
 void parse_ignore_int(struct datatype *dtype)
 {
-    if (!token_is_keyword(token_peek_next(), "int"))
+    if (!token_is_keyword_id(token_peek_next(), KEYWORD_INT))
     {
         return;
     }
@@ -614,7 +624,8 @@ void parse_ignore_int(struct datatype *dtype)
 void parse_keyword(struct history *history)
 {
     struct token *token = token_peek_next();
-    if (is_keyword_variable_modifier(token->sval) || keyword_is_datatype(token->sval))
+    int keyword = token_keyword(token);
+    if (is_keyword_variable_modifier(keyword) || keyword_is_datatype(keyword))
     {
         parse_variable_function_or_struct_union(history);
         return;
@@ -688,7 +699,7 @@ void parser_append_size_for_node(struct history *history, size_t *_variable_size
     compiler_warning(current_process, "parser_append_size_for_node not implemented");
 }
 
-void parser_finalize_body(struct history *history, struct node *body_node, struct vector *body_vec, size_t *_variable_size, struct node *largest_align_eligible_var_node, struct node *largest_possible_var_node)
+void parser_finalize_body(struct history *history, struct node *body_node, VEC(node_ptr) *body_vec, size_t *_variable_size, struct node *largest_align_eligible_var_node, struct node *largest_possible_var_node)
 {
     //     if (history->flags & HISTORY_FLAG_INSIDE_UNION)
     //     {
@@ -716,7 +727,7 @@ void parser_finalize_body(struct history *history, struct node *body_node, struc
     body_node->body.statements = body_vec;
 }
 
-void parse_body_single_statement(size_t *variable_size, struct vector *body_vec, struct history *history)
+void parse_body_single_statement(size_t *variable_size, VEC(node_ptr) *body_vec, struct history *history)
 {
     make_body_node(NULL, 0, false, NULL);
     struct node *body_node = node_pop();
@@ -725,7 +736,7 @@ void parse_body_single_statement(size_t *variable_size, struct vector *body_vec,
     struct node *stmt_node = NULL;
     parse_statement(history_down(history, history->flags));
     stmt_node = node_pop();
-    vector_push(body_vec, &stmt_node);
+    vec_node_ptr_push(body_vec, stmt_node);
 
     parser_append_size_for_node(history, variable_size, stmt_node);
     struct node *largest_var_node = NULL;
@@ -748,7 +759,7 @@ void parse_body(size_t *variable_size, struct history *history)
     {
         variable_size = &tem_size;
     }
-    struct vector *body_vec = vector_create(sizeof(struct node *));
+    VEC(node_ptr) *body_vec = vec_node_ptr_create();
     if (!token_next_is_symbol('{'))
     {
         parse_body_single_statement(variable_size, body_vec, history);
@@ -798,14 +809,18 @@ int parse(compile_process *compiler)
     current_process = compiler;
     parser_last_token = NULL;
     node_set_vector(compiler->node_vec, compiler->node_tree_vec);
+    node_set_arena(compiler->arena);
     struct node *node = NULL;
 
-    vector_set_peek_pointer(compiler->token_vec, 0);
+    if (compiler->token_vec)
+    {
+        vector_set_peek_pointer(&compiler->token_vec->base, 0);
+    }
 
     while (parse_next() == 0)
     {
         node = node_peek();
-        vector_push(compiler->node_tree_vec, &node);
+        vec_node_ptr_push(compiler->node_tree_vec, node);
     }
     return PARSE_ALL_OK;
 }
\ No newline at end of file
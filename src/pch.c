@@ -0,0 +1,399 @@
+#include "compiler.h"
+#include "../helpers/vector.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * 预编译头映像: 保存前置头文件预处理后的 token, 驻留字符串, 数字字面量, 宏定义,
+ * 包含过的头文件以及所有涉及的源文件内容. 映像中只有偏移没有指针, 加载时整个文件
+ * mmap 进来, 源文件内容与驻留字符串直接指向映射, 不重新读取, 分析或哈希.
+ * 任何一个源文件的大小或修改时间变化后映像失效, 重新处理前置头文件并覆盖映像.
+ *
+ * 语法分析还没有接入 compile_file, 前置头文件处理完时作用域与符号表都是空的, 映像中暂不保存.
+ */
+
+#define PCH_MAGIC 0x504d4d43 // "CMMP"
+// 映像中任何结构的格式改变时递增
+#define PCH_VERSION 1
+
+struct pch_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_count;
+    uint32_t literal_count;
+    uint32_t token_count;
+    uint32_t macro_token_count;
+    uint32_t macro_count;
+    uint32_t param_count;
+    uint32_t included_count;
+    uint32_t string_count;
+    uint64_t blob_size;
+};
+
+// 前置头文件与它包含的文件, 映像中的下标即 token 的 file_id
+struct pch_file
+{
+    uint64_t data_offset;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t path_offset;
+    uint32_t path_len;
+};
+
+enum
+{
+    PCH_MACRO_FUNCTION_LIKE = 0b01,
+    PCH_MACRO_VARIADIC = 0b10
+};
+
+struct pch_macro
+{
+    uint32_t name;
+    uint32_t flags;
+    uint32_t param_count;
+    uint32_t params_start;
+    uint32_t body_start;
+    uint32_t body_count;
+};
+
+struct pch_string
+{
+    uint32_t offset;
+    uint32_t len;
+    uint32_t hash;
+};
+
+// 映像按前置头文件的真实路径与头文件搜索路径命名
+static void pch_path(char *path, size_t size, const char *prelude)
+{
+    char key[PATH_MAX * 2];
+    const char *include_path = getenv("CMM_INCLUDE_PATH");
+    int len = snprintf(key, sizeof(key), "%s%c%s", prelude, '\0', include_path ? include_path : "");
+    snprintf(path, size, "%s/%016llx.pch", token_cache_dir(), (unsigned long long)token_cache_hash(key, len));
+}
+
+static size_t pch_expected_size(const struct pch_header *header)
+{
+    return sizeof(*header) +
+           (size_t)header->file_count * sizeof(struct pch_file) +
+           (size_t)header->literal_count * sizeof(struct token_literal) +
+           (size_t)(header->token_count + header->macro_token_count) * sizeof(struct token) +
+           (size_t)header->macro_count * sizeof(struct pch_macro) +
+           (size_t)(header->param_count + header->included_count) * sizeof(uint32_t) +
+           (size_t)header->string_count * sizeof(struct pch_string) +
+           header->blob_size;
+}
+
+// 字符串化与 ## 拼接生成的内容没有对应的磁盘文件, 路径不是绝对路径, 不需要检查
+static bool pch_file_is_current(const struct pch_file *file, const char *path)
+{
+    if (path[0] != '/')
+    {
+        return true;
+    }
+    struct stat st;
+    return stat(path, &st) == 0 && (uint64_t)st.st_size == file->size &&
+           st.st_mtim.tv_sec == file->mtime_sec && st.st_mtim.tv_nsec == file->mtime_nsec;
+}
+
+static void pch_push_tokens(VEC(token) *vector, const struct token *tokens, uint32_t count, uint16_t file_base)
+{
+    int start = vec_token_count(vector);
+    vector_push_n(&vector->base, tokens, count);
+    struct token *pushed = vec_token_at(vector, start);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        pushed[i].file_id += file_base;
+    }
+}
+
+// 加载映像, 返回前置头文件展开后的 token; 映像不存在或已经失效时返回 NULL
+static VEC(token) *pch_map(compile_process *process, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct pch_header))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t size = st.st_size;
+    const char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    const struct pch_header *header = (const struct pch_header *)map;
+    if (header->magic != PCH_MAGIC || header->version != PCH_VERSION || pch_expected_size(header) != size)
+    {
+        munmap((void *)map, size);
+        return NULL;
+    }
+
+    const char *cur = map + sizeof(*header);
+    const struct pch_file *files = (const struct pch_file *)cur;
+    cur += header->file_count * sizeof(struct pch_file);
+    const char *literals = cur;
+    cur += header->literal_count * sizeof(struct token_literal);
+    const struct token *tokens = (const struct token *)cur;
+    cur += header->token_count * sizeof(struct token);
+    const struct token *macro_tokens = (const struct token *)cur;
+    cur += header->macro_token_count * sizeof(struct token);
+    const struct pch_macro *macros = (const struct pch_macro *)cur;
+    cur += header->macro_count * sizeof(struct pch_macro);
+    const uint32_t *params = (const uint32_t *)cur;
+    cur += header->param_count * sizeof(uint32_t);
+    const uint32_t *included = (const uint32_t *)cur;
+    cur += header->included_count * sizeof(uint32_t);
+    const struct pch_string *strings = (const struct pch_string *)cur;
+    const char *blob = cur + header->string_count * sizeof(struct pch_string);
+
+    for (uint32_t i = 0; i < header->file_count; i++)
+    {
+        if (!pch_file_is_current(&files[i], blob + files[i].path_offset))
+        {
+            munmap((void *)map, size);
+            return NULL;
+        }
+    }
+
+    // 映射在整个编译期间保留, 源文件内容与驻留字符串都指向这里, compile_process_free 时解除
+    process->pch_map = map;
+    process->pch_map_size = size;
+    uint16_t file_base = vector_count(process->files);
+    for (uint32_t i = 0; i < header->file_count; i++)
+    {
+        cfile *file = calloc(1, sizeof(cfile));
+        file->abs_path = blob + files[i].path_offset;
+        file->data = blob + files[i].data_offset;
+        file->end = file->data + files[i].size;
+        file->cur = file->end;
+        compile_process_add_file(process, file);
+    }
+    for (uint32_t i = 0; i < header->string_count; i++)
+    {
+        intern_string_id_static(process->strings, blob + strings[i].offset, strings[i].len, strings[i].hash);
+    }
+    vector_push_n(process->literals, literals, header->literal_count);
+    for (uint32_t i = 0; i < header->macro_count; i++)
+    {
+        struct macro *macro = macro_table_entry(process->macros, macros[i].name);
+        macro->defined = true;
+        macro->function_like = macros[i].flags & PCH_MACRO_FUNCTION_LIKE;
+        macro->variadic = macros[i].flags & PCH_MACRO_VARIADIC;
+        macro->param_count = macros[i].param_count;
+        macro->params = malloc(macro->param_count * sizeof(uint32_t));
+        memcpy(macro->params, params + macros[i].params_start, macro->param_count * sizeof(uint32_t));
+        macro->body = vec_token_create();
+        pch_push_tokens(macro->body, macro_tokens + macros[i].body_start, macros[i].body_count, file_base);
+    }
+    for (uint32_t i = 0; i < header->included_count; i++)
+    {
+        const char *included_path = compile_process_file(process, file_base + included[i])->abs_path;
+        vector_push(process->included_once, &included_path);
+    }
+
+    VEC(token) *prelude_tokens = vec_token_create();
+    pch_push_tokens(prelude_tokens, tokens, header->token_count, file_base);
+    return prelude_tokens;
+}
+
+// 写入 count 个 token, file_id 减去 file_base 变为映像中的下标
+static void pch_write_tokens(FILE *out, struct token *tokens, int count, uint16_t file_base)
+{
+    for (int i = 0; i < count; i++)
+    {
+        struct token token = tokens[i];
+        token.file_id -= file_base;
+        fwrite(&token, sizeof(token), 1, out);
+    }
+}
+
+/**
+ * 把前置头文件的处理结果写入映像. 先写入临时文件再改名, 并发的编译进程不会读到写了一半的映像;
+ * 映像只是加速手段, 写入失败时直接放弃.
+ */
+static void pch_store(compile_process *process, VEC(token) *prelude_tokens, const char *path)
+{
+    mkdir(token_cache_dir(), 0755);
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out)
+    {
+        return;
+    }
+
+    // 编号 0 是输入文件, 之后都属于前置头文件
+    uint16_t file_base = 1;
+    struct intern_table *table = process->strings;
+    struct vector *macros = vector_create(sizeof(struct macro *));
+    for (uint32_t i = 0; i <= process->macros->mask; i++)
+    {
+        struct macro *macro = process->macros->slots[i];
+        if (macro && macro->defined)
+        {
+            vector_push(macros, &macro);
+        }
+    }
+    struct vector *included = vector_create(sizeof(uint32_t));
+    for (int i = 0; i < vector_count(process->included_once); i++)
+    {
+        const char *included_path = *(char **)vector_at(process->included_once, i);
+        for (uint32_t file_id = file_base; file_id < (uint32_t)vector_count(process->files); file_id++)
+        {
+            if (S_EQ(compile_process_file(process, file_id)->abs_path, included_path))
+            {
+                uint32_t index = file_id - file_base;
+                vector_push(included, &index);
+                break;
+            }
+        }
+    }
+
+    struct pch_header header = {
+        .magic = PCH_MAGIC,
+        .version = PCH_VERSION,
+        .file_count = vector_count(process->files) - file_base,
+        .literal_count = vector_count(process->literals),
+        .token_count = vec_token_count(prelude_tokens),
+        .macro_count = vector_count(macros),
+        .included_count = vector_count(included),
+        .string_count = table->count,
+    };
+    for (int i = 0; i < vector_count(macros); i++)
+    {
+        struct macro *macro = *(struct macro **)vector_at(macros, i);
+        header.macro_token_count += vec_token_count(macro->body);
+        header.param_count += macro->param_count;
+    }
+    for (uint32_t i = 0; i < header.file_count; i++)
+    {
+        cfile *file = compile_process_file(process, file_base + i);
+        header.blob_size += strlen(file->abs_path) + 1 + (file->end - file->data);
+    }
+    for (int i = 0; i < table->count; i++)
+    {
+        header.blob_size += table->entries[i].len + 1;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+
+    uint64_t blob_offset = 0;
+    for (uint32_t i = 0; i < header.file_count; i++)
+    {
+        cfile *file = compile_process_file(process, file_base + i);
+        struct stat st = {0};
+        stat(file->abs_path, &st);
+        struct pch_file entry = {
+            .path_offset = blob_offset,
+            .path_len = strlen(file->abs_path),
+            .size = file->end - file->data,
+            .mtime_sec = st.st_mtim.tv_sec,
+            .mtime_nsec = st.st_mtim.tv_nsec,
+        };
+        entry.data_offset = blob_offset + entry.path_len + 1;
+        blob_offset = entry.data_offset + entry.size;
+        fwrite(&entry, sizeof(entry), 1, out);
+    }
+    fwrite(vector_data_ptr(process->literals), sizeof(struct token_literal), header.literal_count, out);
+    pch_write_tokens(out, vec_token_data(prelude_tokens), header.token_count, file_base);
+    for (int i = 0; i < vector_count(macros); i++)
+    {
+        struct macro *macro = *(struct macro **)vector_at(macros, i);
+        pch_write_tokens(out, vec_token_data(macro->body), vec_token_count(macro->body), file_base);
+    }
+    uint32_t params_start = 0;
+    uint32_t body_start = 0;
+    for (int i = 0; i < vector_count(macros); i++)
+    {
+        struct macro *macro = *(struct macro **)vector_at(macros, i);
+        struct pch_macro entry = {
+            .name = macro->name,
+            .flags = (macro->function_like ? PCH_MACRO_FUNCTION_LIKE : 0) | (macro->variadic ? PCH_MACRO_VARIADIC : 0),
+            .param_count = macro->param_count,
+            .params_start = params_start,
+            .body_start = body_start,
+            .body_count = vec_token_count(macro->body),
+        };
+        params_start += entry.param_count;
+        body_start += entry.body_count;
+        fwrite(&entry, sizeof(entry), 1, out);
+    }
+    for (int i = 0; i < vector_count(macros); i++)
+    {
+        struct macro *macro = *(struct macro **)vector_at(macros, i);
+        if (macro->param_count > 0)
+        {
+            fwrite(macro->params, sizeof(uint32_t), macro->param_count, out);
+        }
+    }
+    fwrite(vector_data_ptr(included), sizeof(uint32_t), header.included_count, out);
+    uint32_t string_offset = blob_offset;
+    for (int i = 0; i < table->count; i++)
+    {
+        struct pch_string string = {.offset = string_offset, .len = table->entries[i].len, .hash = table->entries[i].hash};
+        fwrite(&string, sizeof(string), 1, out);
+        string_offset += string.len + 1;
+    }
+    for (uint32_t i = 0; i < header.file_count; i++)
+    {
+        cfile *file = compile_process_file(process, file_base + i);
+        fwrite(file->abs_path, 1, strlen(file->abs_path) + 1, out);
+        fwrite(file->data, 1, file->end - file->data, out);
+    }
+    for (int i = 0; i < table->count; i++)
+    {
+        // 带上结尾的 0, 加载后可以直接当作 C 字符串使用
+        fwrite(table->entries[i].str, 1, table->entries[i].len + 1, out);
+    }
+    vector_free(macros);
+    vector_free(included);
+
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        unlink(tmp_path);
+    }
+}
+
+/**
+ * 处理前置头文件 prelude, 返回它展开后的 token, 无法读取时返回 NULL.
+ * 映像中的驻留编号, 字面量下标与文件编号都从空的编译进程开始计, 必须在输入文件的
+ * 词法分析之前调用; 否则只能从源码处理, 也不写入映像.
+ */
+VEC(token) *pch_load(compile_process *process, const char *prelude)
+{
+    char real_path[PATH_MAX];
+    if (!realpath(prelude, real_path))
+    {
+        return NULL;
+    }
+
+    bool fresh = process->strings->count == 0 && vector_count(process->literals) == 0 && vector_count(process->files) == 1;
+    char path[PATH_MAX];
+    pch_path(path, sizeof(path), real_path);
+    VEC(token) *prelude_tokens = fresh ? pch_map(process, path) : NULL;
+    if (prelude_tokens)
+    {
+        return prelude_tokens;
+    }
+
+    prelude_tokens = preprocess_prelude(process, real_path);
+    if (prelude_tokens && fresh)
+    {
+        pch_store(process, prelude_tokens, path);
+    }
+    return prelude_tokens;
+}
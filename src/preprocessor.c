@@ -0,0 +1,1296 @@
+#include "compiler.h"
+#include "token.h"
+#include "../helpers/vector.h"
+#include "../helpers/gap_buffer.h"
+#include <limits.h>
+#include <unistd.h>
+
+/**
+ * 预处理: 在词法分析之后, 语法分析之前展开 #include 与宏.
+ *
+ * 待处理的 token 放在 gap buffer 的右侧, 扫描时逐个移到左侧; 头文件的内容与宏展开的结果
+ * 直接插入到扫描位置, 代价只与插入的 token 数有关, 插入的内容随后被重新扫描.
+ *
+ * 每个头文件在一次编译中只做一次词法分析, 结果按真实路径缓存; 带有 #pragma once
+ * 的头文件只展开一次, 整个文件被 #ifndef X / #define X ... #endif 包住的头文件在
+ * X 已经定义时跳过.
+ * 支持 #define (对象宏, 函数宏, 可变参数, # 与 ##) 与 #undef, 其余的预处理指令原样保留.
+ */
+
+// 防止头文件互相包含时无限展开
+#define PREPROCESSOR_MAX_INCLUDE_DEPTH 200
+#define MACRO_TABLE_INITIAL_SLOTS 256
+
+struct preprocessor_header
+{
+    // realpath 得到的规范路径, 同一个文件经不同的相对路径包含时也能命中缓存
+    char *path;
+    uint16_t file_id;
+    // 头文件的 token, 其中的指令在每次展开时处理; 已去掉 include guard
+    VEC(token) *tokens;
+    // include guard 的宏名, 没有时为 NULL
+    const char *guard;
+    // #pragma once
+    bool once;
+    // 只需包含一次的头文件已经包含过, 包括预编译头中包含过的
+    bool included;
+};
+
+// 插入到扫描位置的一段内容 (宏展开结果或头文件), 其中的 token 全部移出右侧时结束
+struct preprocessor_region
+{
+    // 头文件时为 NULL
+    struct macro *macro;
+    // 以 consumed 计的结束位置
+    size_t end;
+};
+
+// 一个 token 序列的扫描状态: 已处理的 token 在 gap buffer 左侧, 待处理的在右侧
+struct preprocessor_stream
+{
+    struct gap_buffer *tokens;
+    // struct preprocessor_region, 后插入的区域总在先插入的区域内部
+    struct vector *regions;
+    // 已从右侧移走的 token 数
+    size_t consumed;
+    int include_depth;
+    // 处理预处理指令; 宏参数的预展开不处理指令
+    bool directives;
+    // 下一个 token 位于行首
+    bool line_start;
+};
+
+struct preprocessor
+{
+    compile_process *compiler;
+    // struct preprocessor_header *
+    struct vector *headers;
+    // 搜索 <...> 与找不到的 "..." 头文件的目录, 来自 CMM_INCLUDE_PATH (以 ':' 分隔)
+    struct vector *include_dirs;
+    uint32_t va_args;
+
+    // 字符串化与 ## 拼接生成的源码文本登记为一个文件, 生成的 token 指向这里
+    cfile *scratch;
+    uint16_t scratch_id;
+    size_t scratch_capacity;
+    // 拼出字符串化与 ## 拼接的文本, 每次使用前清空
+    struct buffer *spelling;
+};
+
+static struct token *preprocessor_token_at(VEC(token) *tokens, int index)
+{
+    return index < vec_token_count(tokens) ? vec_token_at(tokens, index) : NULL;
+}
+
+// 预处理指令的名字, 如 include, ifndef; 不是标识符或关键字时返回 NULL
+static const char *preprocessor_token_name(struct preprocessor *preprocessor, struct token *token)
+{
+    if (!token || (token->type != TOKEN_TYPE_IDENTIFIER && token->type != TOKEN_TYPE_KEYWORD))
+    {
+        return NULL;
+    }
+    return token_sval(preprocessor->compiler, token);
+}
+
+// tokens[index] 是否是行首的 '#'
+static bool preprocessor_is_directive(VEC(token) *tokens, int index)
+{
+    struct token *token = preprocessor_token_at(tokens, index);
+    if (!token_is_symbol(token, '#'))
+    {
+        return false;
+    }
+    return index == 0 || vec_token_at(tokens, index - 1)->type == TOKEN_TYPE_NEWLINE;
+}
+
+// 从 index 开始的这一行结束后的下标 (换行 token 本身属于这一行)
+static int preprocessor_line_end(VEC(token) *tokens, int index)
+{
+    int count = vec_token_count(tokens);
+    while (index < count && vec_token_at(tokens, index)->type != TOKEN_TYPE_NEWLINE)
+    {
+        index++;
+    }
+    return index < count ? index + 1 : count;
+}
+
+// 位于 tokens[index] 的指令的名字, 不是指令时返回 NULL
+static const char *preprocessor_directive_name(struct preprocessor *preprocessor, VEC(token) *tokens, int index)
+{
+    if (!preprocessor_is_directive(tokens, index))
+    {
+        return NULL;
+    }
+    return preprocessor_token_name(preprocessor, preprocessor_token_at(tokens, index + 1));
+}
+
+// 跳过空行与注释, 返回第一个有内容的 token 的下标
+static int preprocessor_skip_blank(VEC(token) *tokens, int index)
+{
+    struct token *token = NULL;
+    while ((token = preprocessor_token_at(tokens, index)) && (token->type == TOKEN_TYPE_NEWLINE || token->type == TOKEN_TYPE_COMMENT))
+    {
+        index++;
+    }
+    return index;
+}
+
+// 指令 "# name macro" 之后只有注释
+static bool preprocessor_line_is_only(struct preprocessor *preprocessor, VEC(token) *tokens, int index, const char *name, const char **macro)
+{
+    const char *directive = preprocessor_directive_name(preprocessor, tokens, index);
+    if (!directive || !S_EQ(directive, name))
+    {
+        return false;
+    }
+
+    int end = preprocessor_line_end(tokens, index);
+    int next = index + 2;
+    if (macro)
+    {
+        struct token *token = preprocessor_token_at(tokens, next++);
+        // 两者都是驻留字符串, 指针相同即相等
+        if (!token || token->type != TOKEN_TYPE_IDENTIFIER || (*macro && *macro != token_sval(preprocessor->compiler, token)))
+        {
+            return false;
+        }
+        *macro = token_sval(preprocessor->compiler, token);
+    }
+    for (; next < end; next++)
+    {
+        int type = vec_token_at(tokens, next)->type;
+        if (type != TOKEN_TYPE_COMMENT && type != TOKEN_TYPE_NEWLINE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 识别经典的 include guard: 文件的第一条指令是 #ifndef X, 紧接着 #define X,
+ * 最后一条是与之配对的 #endif, 之外只有空行和注释. 识别成功时返回 true,
+ * 在 guard 中给出宏名 X, 在 body_start 与 body_end 中给出 guard 内部的 token 范围.
+ */
+static bool preprocessor_find_guard(struct preprocessor *preprocessor, VEC(token) *tokens, const char **guard, int *body_start, int *body_end)
+{
+    const char *macro = NULL;
+    int start = preprocessor_skip_blank(tokens, 0);
+    if (!preprocessor_line_is_only(preprocessor, tokens, start, "ifndef", &macro))
+    {
+        return false;
+    }
+    int define = preprocessor_skip_blank(tokens, preprocessor_line_end(tokens, start));
+    if (!preprocessor_line_is_only(preprocessor, tokens, define, "define", &macro))
+    {
+        return false;
+    }
+
+    // 找到与 #ifndef 配对的 #endif, 之后不能再有内容
+    int depth = 1;
+    int index = preprocessor_line_end(tokens, define);
+    int count = vec_token_count(tokens);
+    while (index < count)
+    {
+        const char *directive = preprocessor_directive_name(preprocessor, tokens, index);
+        if (directive && (S_EQ(directive, "if") || S_EQ(directive, "ifdef") || S_EQ(directive, "ifndef")))
+        {
+            depth++;
+        }
+        else if (directive && depth == 1 && (S_EQ(directive, "else") || S_EQ(directive, "elif")))
+        {
+            return false;
+        }
+        else if (directive && S_EQ(directive, "endif") && --depth == 0)
+        {
+            break;
+        }
+        index = preprocessor_line_end(tokens, index);
+    }
+    if (depth != 0 || !preprocessor_line_is_only(preprocessor, tokens, index, "endif", NULL))
+    {
+        return false;
+    }
+    if (preprocessor_skip_blank(tokens, preprocessor_line_end(tokens, index)) != count)
+    {
+        return false;
+    }
+
+    *guard = macro;
+    *body_start = preprocessor_line_end(tokens, define);
+    *body_end = index;
+    return true;
+}
+
+static bool preprocessor_has_pragma_once(struct preprocessor *preprocessor, VEC(token) *tokens)
+{
+    for (int i = 0; i < vec_token_count(tokens); i = preprocessor_line_end(tokens, i))
+    {
+        const char *directive = preprocessor_directive_name(preprocessor, tokens, i);
+        if (directive && S_EQ(directive, "pragma"))
+        {
+            const char *argument = preprocessor_token_name(preprocessor, preprocessor_token_at(tokens, i + 2));
+            if (argument && S_EQ(argument, "once"))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+static uint32_t macro_table_hash(uint32_t name)
+{
+    return name * 2654435761u;
+}
+
+static struct macro **macro_table_slot(struct macro_table *table, uint32_t name)
+{
+    uint32_t slot = macro_table_hash(name) & table->mask;
+    while (table->slots[slot] && table->slots[slot]->name != name)
+    {
+        slot = (slot + 1) & table->mask;
+    }
+    return &table->slots[slot];
+}
+
+struct macro *macro_table_get(struct macro_table *table, uint32_t name)
+{
+    struct macro *macro = *macro_table_slot(table, name);
+    return macro && macro->defined ? macro : NULL;
+}
+
+// 保持装载因子不超过 1/2
+struct macro_table *macro_table_create()
+{
+    struct macro_table *table = calloc(1, sizeof(struct macro_table));
+    table->slots = calloc(MACRO_TABLE_INITIAL_SLOTS, sizeof(struct macro *));
+    table->mask = MACRO_TABLE_INITIAL_SLOTS - 1;
+    return table;
+}
+
+static void macro_table_grow(struct macro_table *table)
+{
+    struct macro **old_slots = table->slots;
+    uint32_t old_size = table->mask + 1;
+    table->mask = old_size * 2 - 1;
+    table->slots = calloc(old_size * 2, sizeof(struct macro *));
+    for (uint32_t i = 0; i < old_size; i++)
+    {
+        if (old_slots[i])
+        {
+            *macro_table_slot(table, old_slots[i]->name) = old_slots[i];
+        }
+    }
+    free(old_slots);
+}
+
+// 取出 name 对应的宏, 没有时新建一个未定义的宏
+struct macro *macro_table_entry(struct macro_table *table, uint32_t name)
+{
+    struct macro **slot = macro_table_slot(table, name);
+    if (!*slot)
+    {
+        *slot = calloc(1, sizeof(struct macro));
+        (*slot)->name = name;
+        struct macro *macro = *slot;
+        if (++table->count * 2 > (int)(table->mask + 1))
+        {
+            macro_table_grow(table);
+        }
+        return macro;
+    }
+    return *slot;
+}
+
+static void macro_clear(struct macro *macro)
+{
+    free(macro->params);
+    macro->params = NULL;
+    if (macro->body)
+    {
+        vector_free(&macro->body->base);
+        macro->body = NULL;
+    }
+    macro->defined = false;
+}
+
+void macro_table_free(struct macro_table *table)
+{
+    for (uint32_t i = 0; i <= table->mask; i++)
+    {
+        if (table->slots[i])
+        {
+            macro_clear(table->slots[i]);
+            free(table->slots[i]);
+        }
+    }
+    free(table->slots);
+    free(table);
+}
+
+static struct preprocessor_stream *preprocessor_stream_create(bool directives)
+{
+    struct preprocessor_stream *stream = calloc(1, sizeof(struct preprocessor_stream));
+    stream->tokens = gap_buffer_create(sizeof(struct token));
+    stream->regions = vector_create(sizeof(struct preprocessor_region));
+    stream->directives = directives;
+    stream->line_start = true;
+    return stream;
+}
+
+static void preprocessor_stream_free(struct preprocessor_stream *stream)
+{
+    gap_buffer_free(stream->tokens);
+    vector_free(stream->regions);
+    free(stream);
+}
+
+static struct token *preprocessor_stream_peek(struct preprocessor_stream *stream, size_t index)
+{
+    return gap_buffer_right_at(stream->tokens, index);
+}
+
+// 扫描位置越过的区域结束, 其中的宏重新可以展开
+static void preprocessor_stream_pop_regions(struct preprocessor_stream *stream)
+{
+    struct preprocessor_region *region = NULL;
+    while ((region = vector_back_or_null(stream->regions)) && region->end <= stream->consumed)
+    {
+        if (region->macro)
+        {
+            region->macro->active--;
+        }
+        else
+        {
+            stream->include_depth--;
+        }
+        vector_pop(stream->regions);
+    }
+}
+
+// 把右侧第一个 token 移到左侧, 即输出它
+static void preprocessor_stream_advance(struct preprocessor_stream *stream)
+{
+    gap_buffer_advance(stream->tokens);
+    stream->consumed++;
+    preprocessor_stream_pop_regions(stream);
+}
+
+// 丢弃右侧的前 count 个 token
+static void preprocessor_stream_consume(struct preprocessor_stream *stream, size_t count)
+{
+    gap_buffer_erase(stream->tokens, count);
+    stream->consumed += count;
+    preprocessor_stream_pop_regions(stream);
+}
+
+// 在扫描位置插入 tokens, 它们属于所有尚未结束的区域, 也构成一个新的区域
+static void preprocessor_stream_insert(struct preprocessor_stream *stream, struct token *tokens, int count, struct macro *macro)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    gap_buffer_insert(stream->tokens, tokens, count);
+    struct preprocessor_region *regions = vector_data_ptr(stream->regions);
+    for (int i = 0; i < vector_count(stream->regions); i++)
+    {
+        regions[i].end += count;
+    }
+    vector_push(stream->regions, &(struct preprocessor_region){.macro = macro, .end = stream->consumed + count});
+    if (macro)
+    {
+        macro->active++;
+    }
+    else
+    {
+        stream->include_depth++;
+    }
+}
+
+static bool preprocessor_in_macro(struct preprocessor_stream *stream)
+{
+    struct preprocessor_region *region = vector_back_or_null(stream->regions);
+    return region && region->macro;
+}
+
+// 右侧从 index 开始到换行之前的 token 数
+static size_t preprocessor_stream_line_length(struct preprocessor_stream *stream, size_t index)
+{
+    size_t length = 0;
+    struct token *token = NULL;
+    while ((token = preprocessor_stream_peek(stream, index + length)) && token->type != TOKEN_TYPE_NEWLINE)
+    {
+        length++;
+    }
+    return length;
+}
+
+// 报错位置设为 token 的位置
+static void preprocessor_locate(struct preprocessor *preprocessor, struct token *token)
+{
+    preprocessor->compiler->file_id = token->file_id;
+    preprocessor->compiler->offset = token->offset;
+}
+
+// token 在源码中的拼写
+static const char *preprocessor_spelling(struct preprocessor *preprocessor, struct token *token)
+{
+    return compile_process_file(preprocessor->compiler, token->file_id)->data + token->offset;
+}
+
+// 把文本追加到拼接文件中, 返回它的起始偏移
+static size_t preprocessor_scratch_write(struct preprocessor *preprocessor, const char *text, size_t len)
+{
+    cfile *scratch = preprocessor->scratch;
+    if (!scratch)
+    {
+        scratch = calloc(1, sizeof(cfile));
+        scratch->abs_path = "<scratch space>";
+        scratch->owns_data = true;
+        preprocessor->scratch_capacity = 4096;
+        scratch->data = malloc(preprocessor->scratch_capacity);
+        scratch->end = scratch->data;
+        scratch->cur = scratch->data;
+        preprocessor->scratch = scratch;
+        preprocessor->scratch_id = compile_process_add_file(preprocessor->compiler, scratch);
+    }
+
+    size_t start = scratch->end - scratch->data;
+    // 每段之后加一个换行, 行号即生成的次序
+    size_t size = start + len + 1;
+    if (size > preprocessor->scratch_capacity)
+    {
+        while (size > preprocessor->scratch_capacity)
+        {
+            preprocessor->scratch_capacity *= 2;
+        }
+        scratch->data = realloc((char *)scratch->data, preprocessor->scratch_capacity);
+    }
+    char *data = (char *)scratch->data;
+    memcpy(data + start, text, len);
+    data[start + len] = '\n';
+    scratch->end = scratch->data + size;
+    if (scratch->line_starts)
+    {
+        vector_free(scratch->line_starts);
+        scratch->line_starts = NULL;
+    }
+    return start;
+}
+
+/**
+ * 对拼接文件中 [start, start + len) 的文本做词法分析, token 追加到 out.
+ * 出现词法错误时返回 false.
+ */
+static bool preprocessor_lex_scratch(struct preprocessor *preprocessor, size_t start, size_t len, VEC(token) *out)
+{
+    cfile piece = *preprocessor->scratch;
+    piece.cur = piece.data + start;
+    piece.end = piece.data + start + len;
+    compile_process scratch_process = *preprocessor->compiler;
+    scratch_process.input_file = &piece;
+    scratch_process.file_id = preprocessor->scratch_id;
+
+    lex_process *lexer = lex_process_create(&scratch_process, &compiler_lex_functions, NULL);
+    lexer->flags |= LEX_PROCESS_FLAG_CHUNK;
+    jmp_buf recover;
+    lexer->recover = &recover;
+    if (setjmp(recover))
+    {
+        lex_process_free(lexer);
+        return false;
+    }
+    lex_begin(lexer);
+    struct token *token = NULL;
+    while ((token = lex_next_token(lexer)))
+    {
+        token->offset += start;
+        vec_token_push(out, *token);
+        lexer->last_token = vec_token_back(out);
+    }
+    lex_process_free(lexer);
+    return true;
+}
+
+// 对头文件做词法分析, 分析器共用编译进程的驻留表与字面量池
+static VEC(token) *preprocessor_lex_file(struct preprocessor *preprocessor, cfile *file, uint16_t file_id)
+{
+    compile_process header_process = *preprocessor->compiler;
+    header_process.input_file = file;
+    header_process.file_id = file_id;
+
+    lex_process *lexer = lex_process_create(&header_process, &compiler_lex_functions, NULL);
+    lex_begin(lexer);
+    struct token *token = NULL;
+    while ((token = lex_next_token(lexer)))
+    {
+        vec_token_push(lexer->token_vec, *token);
+        lexer->last_token = vec_token_back(lexer->token_vec);
+    }
+
+    VEC(token) *tokens = lexer->token_vec;
+    lexer->token_vec = vec_token_create();
+    lex_process_free(lexer);
+    return tokens;
+}
+
+static struct preprocessor_header *preprocessor_load_header(struct preprocessor *preprocessor, const char *path)
+{
+    vector_set_peek_pointer(preprocessor->headers, 0);
+    struct preprocessor_header *header = vector_peek_ptr(preprocessor->headers);
+    while (header)
+    {
+        if (S_EQ(header->path, path))
+        {
+            return header;
+        }
+        header = vector_peek_ptr(preprocessor->headers);
+    }
+
+    cfile *file = cfile_open(path);
+    if (!file)
+    {
+        return NULL;
+    }
+
+    header = calloc(1, sizeof(struct preprocessor_header));
+    header->path = arena_alloc(preprocessor->compiler->arena, strlen(path) + 1);
+    strcpy(header->path, path);
+    file->abs_path = header->path;
+    header->file_id = compile_process_add_file(preprocessor->compiler, file);
+    VEC(token) *tokens = preprocessor_lex_file(preprocessor, file, header->file_id);
+
+    int body_start = 0;
+    int body_end = vec_token_count(tokens);
+    preprocessor_find_guard(preprocessor, tokens, &header->guard, &body_start, &body_end);
+    header->once = preprocessor_has_pragma_once(preprocessor, tokens);
+    for (int i = 0; i < vector_count(preprocessor->compiler->included_once); i++)
+    {
+        if (S_EQ(*(char **)vector_at(preprocessor->compiler->included_once, i), header->path))
+        {
+            header->included = true;
+        }
+    }
+    header->tokens = vec_token_create();
+    vector_push_n(&header->tokens->base, vec_token_at(tokens, body_start), body_end - body_start);
+    vector_free(&tokens->base);
+
+    vector_push(preprocessor->headers, &header);
+    return header;
+}
+
+// 在 dir 中查找 name, 找到时在 path 中返回规范路径
+static bool preprocessor_try_path(const char *dir, size_t dir_len, const char *name, char *path)
+{
+    char candidate[PATH_MAX];
+    if (dir_len > 0)
+    {
+        snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)dir_len, dir, name);
+    }
+    else
+    {
+        snprintf(candidate, sizeof(candidate), "%s", name);
+    }
+    return access(candidate, R_OK) == 0 && realpath(candidate, path);
+}
+
+// "..." 先在当前文件所在的目录中查找, <...> 与找不到的 "..." 再依次查找 include_dirs
+static bool preprocessor_resolve(struct preprocessor *preprocessor, const char *name, bool angled, uint16_t file_id, char *path)
+{
+    if (name[0] == '/')
+    {
+        return preprocessor_try_path(NULL, 0, name, path);
+    }
+    if (!angled)
+    {
+        const char *current = compile_process_file(preprocessor->compiler, file_id)->abs_path;
+        const char *slash = strrchr(current, '/');
+        size_t dir_len = slash ? (size_t)(slash - current) : 0;
+        if (preprocessor_try_path(slash ? current : ".", slash ? dir_len : 1, name, path))
+        {
+            return true;
+        }
+    }
+
+    vector_set_peek_pointer(preprocessor->include_dirs, 0);
+    const char *dir = vector_peek_ptr(preprocessor->include_dirs);
+    while (dir)
+    {
+        if (preprocessor_try_path(dir, strlen(dir), name, path))
+        {
+            return true;
+        }
+        dir = vector_peek_ptr(preprocessor->include_dirs);
+    }
+    return false;
+}
+
+// 把头文件的内容插入到扫描位置
+static void preprocessor_enter_header(struct preprocessor *preprocessor, struct preprocessor_stream *stream, struct preprocessor_header *header)
+{
+    compile_process *compiler = preprocessor->compiler;
+    if (header->once && header->included)
+    {
+        return;
+    }
+    // 带 include guard 的头文件在宏已经定义时整个位于 #ifndef 之外
+    uint32_t guard = header->guard ? intern_string_id(compiler->strings, header->guard, strlen(header->guard)) : 0;
+    if (header->guard && macro_table_get(compiler->macros, guard))
+    {
+        return;
+    }
+    if (stream->include_depth >= PREPROCESSOR_MAX_INCLUDE_DEPTH)
+    {
+        compiler_error(compiler, "#include 嵌套过深, 可能存在循环包含\n");
+    }
+
+    if (header->once && !header->included)
+    {
+        vector_push(compiler->included_once, &header->path);
+    }
+    header->included = true;
+    if (header->guard)
+    {
+        // 去掉的 #define X 在这里补上
+        struct macro *macro = macro_table_entry(compiler->macros, guard);
+        macro->defined = true;
+        macro->body = vec_token_create();
+    }
+    preprocessor_stream_insert(stream, vector_data_ptr(&header->tokens->base), vec_token_count(header->tokens), NULL);
+    stream->line_start = true;
+}
+
+// 处理 #include, stream 右侧从 '#' 开始, 共 length 个 token
+static void preprocessor_include(struct preprocessor *preprocessor, struct preprocessor_stream *stream, size_t length)
+{
+    compile_process *compiler = preprocessor->compiler;
+    struct token *directive = preprocessor_stream_peek(stream, 0);
+    uint16_t file_id = directive->file_id;
+    preprocessor_locate(preprocessor, directive);
+
+    struct token *name_token = length > 2 ? preprocessor_stream_peek(stream, 2) : NULL;
+    if (!name_token || name_token->type != TOKEN_TYPE_STRING)
+    {
+        compiler_error(compiler, "#include 需要 \"文件名\" 或 <文件名>\n");
+    }
+    const char *name = token_sval(compiler, name_token);
+    bool angled = *preprocessor_spelling(preprocessor, name_token) == '<';
+    preprocessor_stream_consume(stream, length);
+
+    char path[PATH_MAX];
+    if (!preprocessor_resolve(preprocessor, name, angled, file_id, path))
+    {
+        if (!angled)
+        {
+            compiler_error(compiler, "找不到头文件 \"%s\"\n", name);
+        }
+        // 还没有自己的标准库头文件, 找不到的 <...> 只给出警告
+        compiler_warning(compiler, "找不到头文件 <%s>, 已忽略\n", name);
+        return;
+    }
+
+    struct preprocessor_header *header = preprocessor_load_header(preprocessor, path);
+    if (!header)
+    {
+        compiler_error(compiler, "无法读取头文件 %s\n", path);
+    }
+    preprocessor_enter_header(preprocessor, stream, header);
+}
+
+// 宏的第 index 个参数名是 name 时返回 index, 否则返回 -1
+static int macro_param_index(struct macro *macro, struct token *token)
+{
+    if (!macro->function_like || token->type != TOKEN_TYPE_IDENTIFIER)
+    {
+        return -1;
+    }
+    for (int i = 0; i < macro->param_count; i++)
+    {
+        if (macro->params[i] == token->str_id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 处理 #define, stream 右侧从 '#' 开始, 共 length 个 token
+static void preprocessor_define(struct preprocessor *preprocessor, struct preprocessor_stream *stream, size_t length)
+{
+    compile_process *compiler = preprocessor->compiler;
+    preprocessor_locate(preprocessor, preprocessor_stream_peek(stream, 0));
+    struct token *name = length > 2 ? preprocessor_stream_peek(stream, 2) : NULL;
+    if (!name || name->type != TOKEN_TYPE_IDENTIFIER)
+    {
+        compiler_error(compiler, "#define 之后需要宏名\n");
+    }
+
+    struct macro *macro = macro_table_entry(preprocessor->compiler->macros, name->str_id);
+    macro_clear(macro);
+    macro->defined = true;
+    macro->function_like = false;
+    macro->variadic = false;
+    macro->param_count = 0;
+    macro->body = vec_token_create();
+
+    size_t index = 3;
+    struct token *token = preprocessor_stream_peek(stream, index);
+    // 宏名与 '(' 之间没有空白才是函数宏
+    if (index < length && token_is_operator(token, OP_LPAREN) && !(name->flags & TOKEN_FLAG_WHITESPACE))
+    {
+        macro->function_like = true;
+        macro->params = malloc(length * sizeof(uint32_t));
+        index++;
+        bool expect_param = true;
+        while (true)
+        {
+            token = index < length ? preprocessor_stream_peek(stream, index++) : NULL;
+            if (token && expect_param && token->type == TOKEN_TYPE_IDENTIFIER && !macro->variadic)
+            {
+                macro->params[macro->param_count++] = token->str_id;
+            }
+            else if (token && expect_param && token_is_operator(token, OP_ELLIPSIS) && !macro->variadic)
+            {
+                macro->variadic = true;
+                macro->params[macro->param_count++] = preprocessor->va_args;
+            }
+            else if (token && !expect_param && token_is_operator(token, OP_COMMA) && !macro->variadic)
+            {
+                expect_param = true;
+                continue;
+            }
+            else if (token && token_is_symbol(token, ')') && (!expect_param || macro->param_count == 0))
+            {
+                break;
+            }
+            else
+            {
+                compiler_error(compiler, "宏 %s 的参数列表格式错误\n", token_sval(compiler, name));
+            }
+            expect_param = false;
+        }
+    }
+
+    for (; index < length; index++)
+    {
+        token = preprocessor_stream_peek(stream, index);
+        if (token->type != TOKEN_TYPE_COMMENT)
+        {
+            vec_token_push(macro->body, *token);
+        }
+    }
+    preprocessor_stream_consume(stream, length);
+}
+
+// 处理 #undef, stream 右侧从 '#' 开始, 共 length 个 token
+static void preprocessor_undef(struct preprocessor *preprocessor, struct preprocessor_stream *stream, size_t length)
+{
+    preprocessor_locate(preprocessor, preprocessor_stream_peek(stream, 0));
+    struct token *name = length > 2 ? preprocessor_stream_peek(stream, 2) : NULL;
+    if (!name || name->type != TOKEN_TYPE_IDENTIFIER)
+    {
+        compiler_error(preprocessor->compiler, "#undef 之后需要宏名\n");
+    }
+    struct macro *macro = macro_table_get(preprocessor->compiler->macros, name->str_id);
+    if (macro)
+    {
+        macro_clear(macro);
+    }
+    preprocessor_stream_consume(stream, length);
+}
+
+// 处理行首 '#' 开始的一行 (不含换行)
+static void preprocessor_directive(struct preprocessor *preprocessor, struct preprocessor_stream *stream)
+{
+    size_t length = preprocessor_stream_line_length(stream, 0);
+    const char *name = length > 1 ? preprocessor_token_name(preprocessor, preprocessor_stream_peek(stream, 1)) : NULL;
+    if (name && S_EQ(name, "include"))
+    {
+        preprocessor_include(preprocessor, stream, length);
+        return;
+    }
+    if (name && S_EQ(name, "define"))
+    {
+        preprocessor_define(preprocessor, stream, length);
+        return;
+    }
+    if (name && S_EQ(name, "undef"))
+    {
+        preprocessor_undef(preprocessor, stream, length);
+        return;
+    }
+    if (name && S_EQ(name, "pragma") && length > 2)
+    {
+        const char *argument = preprocessor_token_name(preprocessor, preprocessor_stream_peek(stream, 2));
+        if (argument && S_EQ(argument, "once"))
+        {
+            preprocessor_stream_consume(stream, length);
+            return;
+        }
+    }
+
+    // 其余指令原样输出, 其中的宏名不展开
+    for (size_t i = 0; i < length; i++)
+    {
+        preprocessor_stream_advance(stream);
+    }
+}
+
+// 函数宏调用的实参, 指向 tokens 中的一段
+struct macro_argument
+{
+    int start;
+    int count;
+    // 完全展开后的结果, 首次用到时计算
+    VEC(token) *expanded;
+};
+
+struct macro_arguments
+{
+    VEC(token) *tokens;
+    int count;
+    struct macro_argument *items;
+};
+
+static void preprocessor_run(struct preprocessor *preprocessor, struct preprocessor_stream *stream);
+
+/**
+ * 读取函数宏调用的实参. stream 右侧从宏名开始, 宏名之后 (跳过换行与注释) 不是 '(' 时
+ * 不是调用, 返回 0; 否则返回调用占用的 token 数.
+ */
+static size_t preprocessor_read_arguments(struct preprocessor *preprocessor, struct preprocessor_stream *stream, struct macro *macro, struct macro_arguments *arguments)
+{
+    size_t index = 1;
+    struct token *token = NULL;
+    while ((token = preprocessor_stream_peek(stream, index)) && (token->type == TOKEN_TYPE_NEWLINE || token->type == TOKEN_TYPE_COMMENT))
+    {
+        index++;
+    }
+    if (!token_is_operator(token, OP_LPAREN))
+    {
+        return 0;
+    }
+    index++;
+
+    arguments->tokens = vec_token_create();
+    arguments->count = 0;
+    struct vector *items = vector_create(sizeof(struct macro_argument));
+    struct macro_argument current = {.start = 0};
+    int depth = 0;
+    while (true)
+    {
+        token = preprocessor_stream_peek(stream, index++);
+        if (!token)
+        {
+            preprocessor_locate(preprocessor, preprocessor_stream_peek(stream, 0));
+            compiler_error(preprocessor->compiler, "宏 %s 的调用缺少 ')'\n", intern_str(preprocessor->compiler->strings, macro->name));
+        }
+        if (token->type == TOKEN_TYPE_NEWLINE || token->type == TOKEN_TYPE_COMMENT)
+        {
+            continue;
+        }
+
+        if (depth == 0 && (token_is_symbol(token, ')') ||
+                           (token_is_operator(token, OP_COMMA) && !(macro->variadic && vector_count(items) == macro->param_count - 1))))
+        {
+            current.count = vec_token_count(arguments->tokens) - current.start;
+            vector_push(items, &current);
+            current = (struct macro_argument){.start = vec_token_count(arguments->tokens)};
+            if (token_is_symbol(token, ')'))
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (token_is_operator(token, OP_LPAREN))
+        {
+            depth++;
+        }
+        else if (token_is_symbol(token, ')'))
+        {
+            depth--;
+        }
+        vec_token_push(arguments->tokens, *token);
+    }
+
+    arguments->count = vector_count(items);
+    arguments->items = malloc(arguments->count * sizeof(struct macro_argument));
+    memcpy(arguments->items, vector_data_ptr(items), arguments->count * sizeof(struct macro_argument));
+    vector_free(items);
+    return index;
+}
+
+static void preprocessor_free_arguments(struct macro_arguments *arguments)
+{
+    for (int i = 0; i < arguments->count; i++)
+    {
+        if (arguments->items[i].expanded)
+        {
+            vector_free(&arguments->items[i].expanded->base);
+        }
+    }
+    free(arguments->items);
+    vector_free(&arguments->tokens->base);
+}
+
+// 实参完全展开后的 token, 展开时就像它们单独组成一个文件
+static VEC(token) *preprocessor_expanded_argument(struct preprocessor *preprocessor, struct macro_arguments *arguments, int index)
+{
+    struct macro_argument *argument = &arguments->items[index];
+    if (!argument->expanded)
+    {
+        struct preprocessor_stream *stream = preprocessor_stream_create(false);
+        if (argument->count > 0)
+        {
+            gap_buffer_insert(stream->tokens, vec_token_at(arguments->tokens, argument->start), argument->count);
+        }
+        preprocessor_run(preprocessor, stream);
+
+        argument->expanded = vec_token_create();
+        vector_push_n(&argument->expanded->base, gap_buffer_left_data(stream->tokens), gap_buffer_left_count(stream->tokens));
+        preprocessor_stream_free(stream);
+    }
+    return argument->expanded;
+}
+
+// # 运算符: 把实参的拼写变成字符串
+static struct token preprocessor_stringize(struct preprocessor *preprocessor, struct macro_arguments *arguments, int index, struct token *hash)
+{
+    struct macro_argument *argument = &arguments->items[index];
+    struct buffer *buffer = preprocessor->spelling;
+    buffer_clear(buffer);
+    buffer_write(buffer, '"');
+    for (int i = 0; i < argument->count; i++)
+    {
+        struct token *token = vec_token_at(arguments->tokens, argument->start + i);
+        buffer_write_bytes(buffer, preprocessor_spelling(preprocessor, token), token->length);
+        if (i + 1 < argument->count && (token->flags & TOKEN_FLAG_WHITESPACE))
+        {
+            buffer_write(buffer, ' ');
+        }
+    }
+    buffer_write(buffer, '"');
+
+    // 拼写写入拼接文件, 字符串的值不含两端的引号
+    size_t offset = preprocessor_scratch_write(preprocessor, buffer_ptr(buffer), buffer->len);
+    struct token result = {
+        .type = TOKEN_TYPE_STRING,
+        .flags = hash->flags,
+        .file_id = preprocessor->scratch_id,
+        .offset = offset,
+        .length = buffer->len,
+        .str_id = intern_string_id(preprocessor->compiler->strings, (const char *)buffer_ptr(buffer) + 1, buffer->len - 2),
+    };
+    return result;
+}
+
+// ## 运算符: 把两个 token 的拼写连在一起重新做词法分析, 结果必须是一个 token
+static struct token preprocessor_paste(struct preprocessor *preprocessor, struct token *left, struct token *right, struct token *hash)
+{
+    struct buffer *buffer = preprocessor->spelling;
+    buffer_clear(buffer);
+    buffer_write_bytes(buffer, preprocessor_spelling(preprocessor, left), left->length);
+    buffer_write_bytes(buffer, preprocessor_spelling(preprocessor, right), right->length);
+    size_t offset = preprocessor_scratch_write(preprocessor, buffer_ptr(buffer), buffer->len);
+
+    VEC(token) *tokens = vec_token_create();
+    if (!preprocessor_lex_scratch(preprocessor, offset, buffer->len, tokens) || vec_token_count(tokens) != 1)
+    {
+        preprocessor_locate(preprocessor, hash);
+        compiler_error(preprocessor->compiler, "## 拼接得到的 \"%.*s\" 不是一个有效的 token\n", buffer->len, (char *)buffer_ptr(buffer));
+    }
+    struct token result = *vec_token_at(tokens, 0);
+    result.flags = (result.flags & ~TOKEN_FLAG_WHITESPACE) | (right->flags & TOKEN_FLAG_WHITESPACE);
+    vector_free(&tokens->base);
+    return result;
+}
+
+static bool preprocessor_is_paste(VEC(token) *body, int index)
+{
+    struct token *first = index < vec_token_count(body) ? vec_token_at(body, index) : NULL;
+    struct token *second = index + 1 < vec_token_count(body) ? vec_token_at(body, index + 1) : NULL;
+    return token_is_symbol(first, '#') && token_is_symbol(second, '#') && !(first->flags & TOKEN_FLAG_WHITESPACE);
+}
+
+/**
+ * 用实参替换宏的替换列表, 结果追加到 out. 与 # 或 ## 相邻的实参使用原始的 token,
+ * 其余的实参先完全展开.
+ */
+static void preprocessor_substitute(struct preprocessor *preprocessor, struct macro *macro, struct macro_arguments *arguments, VEC(token) *out)
+{
+    VEC(token) *body = macro->body;
+    int count = vec_token_count(body);
+    // 上一个写入 out 的是一个空的实参, ## 的左侧为空
+    bool left_empty = false;
+    for (int i = 0; i < count; i++)
+    {
+        struct token *token = vec_token_at(body, i);
+        if (preprocessor_is_paste(body, i) && i + 2 < count)
+        {
+            struct token *hash = token;
+            struct token *right = vec_token_at(body, i + 2);
+            int param = macro_param_index(macro, right);
+            struct token *right_tokens = right;
+            int right_count = 1;
+            if (param >= 0)
+            {
+                right_tokens = vec_token_at(arguments->tokens, arguments->items[param].start);
+                right_count = arguments->items[param].count;
+            }
+
+            if (right_count > 0 && !left_empty && vec_token_count(out) > 0)
+            {
+                struct token pasted = preprocessor_paste(preprocessor, vector_back(&out->base), &right_tokens[0], hash);
+                vector_pop(&out->base);
+                vec_token_push(out, pasted);
+                right_tokens++;
+                right_count--;
+            }
+            vector_push_n(&out->base, right_tokens, right_count);
+            left_empty = left_empty && right_count == 0;
+            i += 2;
+            continue;
+        }
+
+        if (macro->function_like && token_is_symbol(token, '#') && i + 1 < count)
+        {
+            int param = macro_param_index(macro, vec_token_at(body, i + 1));
+            if (param >= 0)
+            {
+                struct token string = preprocessor_stringize(preprocessor, arguments, param, token);
+                vec_token_push(out, string);
+                left_empty = false;
+                i++;
+                continue;
+            }
+        }
+
+        int param = macro_param_index(macro, token);
+        if (param >= 0)
+        {
+            struct macro_argument *argument = &arguments->items[param];
+            if (preprocessor_is_paste(body, i + 1))
+            {
+                vector_push_n(&out->base, vec_token_at(arguments->tokens, argument->start), argument->count);
+            }
+            else
+            {
+                VEC(token) *expanded = preprocessor_expanded_argument(preprocessor, arguments, param);
+                vector_push_n(&out->base, vec_token_data(expanded), vec_token_count(expanded));
+            }
+            left_empty = argument->count == 0;
+            continue;
+        }
+
+        vec_token_push(out, *token);
+        left_empty = false;
+    }
+}
+
+/**
+ * 展开 stream 右侧开头的宏. 函数宏之后没有 '(' 时不展开, 返回 false.
+ * 展开结果替换宏调用插入到扫描位置, 重新扫描时这个宏不再展开.
+ */
+static bool preprocessor_expand(struct preprocessor *preprocessor, struct preprocessor_stream *stream, struct macro *macro)
+{
+    struct token name = *preprocessor_stream_peek(stream, 0);
+    struct macro_arguments arguments = {0};
+    size_t length = 1;
+    if (macro->function_like)
+    {
+        length = preprocessor_read_arguments(preprocessor, stream, macro, &arguments);
+        if (length == 0)
+        {
+            return false;
+        }
+
+        // 没有参数的宏以 () 调用时读到一个空实参
+        int expected = macro->param_count;
+        if (expected == 0 && arguments.count == 1 && arguments.items[0].count == 0)
+        {
+            arguments.count = 0;
+        }
+        if (macro->variadic && arguments.count == expected - 1)
+        {
+            // 省略了可变参数, __VA_ARGS__ 为空
+            arguments.items = realloc(arguments.items, expected * sizeof(struct macro_argument));
+            arguments.items[arguments.count++] = (struct macro_argument){.start = vec_token_count(arguments.tokens)};
+        }
+        if (arguments.count != expected)
+        {
+            preprocessor_locate(preprocessor, &name);
+            compiler_error(preprocessor->compiler, "宏 %s 需要 %d 个参数, 实际传入了 %d 个\n", intern_str(preprocessor->compiler->strings, macro->name), expected, arguments.count);
+        }
+    }
+
+    VEC(token) *expansion = vec_token_create();
+    preprocessor_substitute(preprocessor, macro, &arguments, expansion);
+    struct token *tokens = vector_data_ptr(&expansion->base);
+    int count = vec_token_count(expansion);
+    if (count > 0)
+    {
+        // 展开结果之后是否有空白取决于宏调用之后
+        struct token *last = preprocessor_stream_peek(stream, length - 1);
+        tokens[count - 1].flags = (tokens[count - 1].flags & ~TOKEN_FLAG_WHITESPACE) | (last->flags & TOKEN_FLAG_WHITESPACE);
+    }
+    // 宏调用可能是外层展开结果的最后一个 token, 外层区域要等到这次的展开结果扫描完才结束,
+    // 否则 #define A B, #define B A 会无限展开
+    gap_buffer_erase(stream->tokens, length);
+    stream->consumed += length;
+    preprocessor_stream_insert(stream, tokens, count, macro);
+    preprocessor_stream_pop_regions(stream);
+
+    vector_free(&expansion->base);
+    if (macro->function_like)
+    {
+        preprocessor_free_arguments(&arguments);
+    }
+    return true;
+}
+
+// 扫描 stream 直到右侧为空, 处理指令, 展开宏
+static void preprocessor_run(struct preprocessor *preprocessor, struct preprocessor_stream *stream)
+{
+    struct token *token = NULL;
+    while ((token = preprocessor_stream_peek(stream, 0)))
+    {
+        if (stream->directives && stream->line_start && token_is_symbol(token, '#') && !preprocessor_in_macro(stream))
+        {
+            // 指令之后是换行; #include 插入的头文件从行首开始
+            stream->line_start = false;
+            preprocessor_directive(preprocessor, stream);
+            continue;
+        }
+
+        if (token->type == TOKEN_TYPE_IDENTIFIER && !(token->flags & TOKEN_FLAG_NO_EXPAND))
+        {
+            struct macro *macro = macro_table_get(preprocessor->compiler->macros, token->str_id);
+            if (macro && macro->active)
+            {
+                // 在自己的展开结果中出现的宏名永远不再展开
+                token->flags |= TOKEN_FLAG_NO_EXPAND;
+            }
+            else if (macro && preprocessor_expand(preprocessor, stream, macro))
+            {
+                // 宏调用之后已不在行首, 即使展开结果为空, 同一行之后的 '#' 也不是指令
+                stream->line_start = false;
+                continue;
+            }
+        }
+
+        stream->line_start = token->type == TOKEN_TYPE_NEWLINE || (stream->line_start && token->type == TOKEN_TYPE_COMMENT);
+        preprocessor_stream_advance(stream);
+    }
+}
+
+static struct vector *preprocessor_include_dirs()
+{
+    struct vector *dirs = vector_create(sizeof(char *));
+    const char *env = getenv("CMM_INCLUDE_PATH");
+    while (env && *env)
+    {
+        const char *colon = strchr(env, ':');
+        size_t len = colon ? (size_t)(colon - env) : strlen(env);
+        if (len > 0)
+        {
+            char *dir = strndup(env, len);
+            vector_push(dirs, &dir);
+        }
+        env = colon ? colon + 1 : NULL;
+    }
+    return dirs;
+}
+
+static void preprocessor_init(struct preprocessor *preprocessor, compile_process *process)
+{
+    *preprocessor = (struct preprocessor){
+        .compiler = process,
+        .headers = vector_create(sizeof(struct preprocessor_header *)),
+        .include_dirs = preprocessor_include_dirs(),
+        .va_args = intern_string_id(process->strings, "__VA_ARGS__", strlen("__VA_ARGS__")),
+        .spelling = buffer_create_arena(process->arena),
+    };
+}
+
+// 宏表与包含过的头文件属于编译进程, 之后的预处理还要用到
+static void preprocessor_free(struct preprocessor *preprocessor)
+{
+    // 头文件的 cfile 与真实路径在整个编译期间保留, token 的位置信息要用到
+    vector_set_peek_pointer(preprocessor->headers, 0);
+    struct preprocessor_header *header = vector_peek_ptr(preprocessor->headers);
+    while (header)
+    {
+        vector_free(&header->tokens->base);
+        free(header);
+        header = vector_peek_ptr(preprocessor->headers);
+    }
+    vector_free(preprocessor->headers);
+    vector_set_peek_pointer(preprocessor->include_dirs, 0);
+    char *dir = vector_peek_ptr(preprocessor->include_dirs);
+    while (dir)
+    {
+        free(dir);
+        dir = vector_peek_ptr(preprocessor->include_dirs);
+    }
+    vector_free(preprocessor->include_dirs);
+}
+
+// 扫描结束后 gap buffer 左侧即预处理的结果
+static VEC(token) *preprocessor_stream_output(struct preprocessor_stream *stream)
+{
+    VEC(token) *output = vec_token_create();
+    vector_push_n(&output->base, gap_buffer_left_data(stream->tokens), gap_buffer_left_count(stream->tokens));
+    return output;
+}
+
+// 展开 process->token_vec 中的 #include 与宏, 结果替换 process->token_vec
+int preprocess(compile_process *process)
+{
+    struct preprocessor preprocessor;
+    preprocessor_init(&preprocessor, process);
+
+    struct preprocessor_stream *stream = preprocessor_stream_create(true);
+    gap_buffer_insert(stream->tokens, vector_data_ptr(&process->token_vec->base), vec_token_count(process->token_vec));
+    preprocessor_run(&preprocessor, stream);
+    process->token_vec = preprocessor_stream_output(stream);
+
+    preprocessor_stream_free(stream);
+    preprocessor_free(&preprocessor);
+    return PREPROCESS_ALL_OK;
+}
+
+/**
+ * 预处理前置头文件 path, 就像它在输入文件的开头被包含一样: 其中定义的宏
+ * 与包含过的头文件对输入文件可见. 返回展开后的 token, 文件无法读取时返回 NULL.
+ */
+VEC(token) *preprocess_prelude(compile_process *process, const char *path)
+{
+    char real_path[PATH_MAX];
+    if (!realpath(path, real_path))
+    {
+        return NULL;
+    }
+
+    struct preprocessor preprocessor;
+    preprocessor_init(&preprocessor, process);
+    struct preprocessor_header *header = preprocessor_load_header(&preprocessor, real_path);
+    VEC(token) *output = NULL;
+    if (header)
+    {
+        struct preprocessor_stream *stream = preprocessor_stream_create(true);
+        preprocessor_enter_header(&preprocessor, stream, header);
+        preprocessor_run(&preprocessor, stream);
+        output = preprocessor_stream_output(stream);
+        preprocessor_stream_free(stream);
+    }
+    preprocessor_free(&preprocessor);
+
+    // 报错位置指向过头文件, 恢复到输入文件, 之后输入文件的 token 以它标记
+    process->file_id = 0;
+    process->offset = 0;
+    return output;
+}
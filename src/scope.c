@@ -2,12 +2,12 @@
 #include <assert.h>
 #include "../helpers/vector.h"
 
-struct scope *scope_alloc()
+struct scope *scope_alloc(struct compile_process *process)
 {
-    struct scope *scope = calloc(sizeof(struct scope), 1);
-    scope->entities = vector_create(sizeof(void *));
-    vector_set_peek_pointer_end(scope->entities);
-    vector_set_flag(scope->entities, VECTOR_FLAG_PEEK_DECREMENT);
+    struct scope *scope = arena_calloc(process->arena, sizeof(struct scope));
+    scope->entities = vec_ptr_create();
+    vector_set_peek_pointer_end(&scope->entities->base);
+    vector_set_flag(&scope->entities->base, VECTOR_FLAG_PEEK_DECREMENT);
 
     return scope;
 }
@@ -18,7 +18,7 @@ struct scope *scope_create_root(struct compile_process *process)
     assert(!process->scope.root);
     assert(!process->scope.current);
 
-    struct scope *root_scope = scope_alloc();
+    struct scope *root_scope = scope_alloc(process);
     process->scope.root = root_scope;
     process->scope.current = root_scope;
     return root_scope;
@@ -35,7 +35,7 @@ struct scope *scope_new(struct compile_process *process, int flags)
     assert(process->scope.root);
     assert(process->scope.current);
 
-    struct scope *new_scope = scope_alloc();
+    struct scope *new_scope = scope_alloc(process);
     new_scope->flags = flags;
     new_scope->parent = process->scope.current;
     process->scope.current = new_scope;
@@ -43,31 +43,29 @@ struct scope *scope_new(struct compile_process *process, int flags)
 
 void scope_iteration_start(struct scope *scope)
 {
-    vector_set_peek_pointer(scope->entities, 0);
+    vector_set_peek_pointer(&scope->entities->base, 0);
 
     // Decrementing vectors our iteration should start at the end.
-    if (scope->entities->flags & VECTOR_FLAG_PEEK_DECREMENT)
+    if (scope->entities->base.flags & VECTOR_FLAG_PEEK_DECREMENT)
     {
-        vector_set_peek_pointer_end(scope->entities);
+        vector_set_peek_pointer_end(&scope->entities->base);
     }
 }
 
 void *scope_iterate_back(struct scope *scope)
 {
-    if (vector_count(scope->entities) == 0)
-        return NULL;
-
-    return *(void **)(vector_peek(scope->entities));
+    void **entity = vec_ptr_peek(scope->entities);
+    return entity ? *entity : NULL;
 }
 
 void *scope_last_entity_at_scope(struct scope *scope)
 {
-    if (!vector_count(scope->entities))
+    if (!vec_ptr_count(scope->entities))
     {
         return NULL;
     }
 
-    return *(void **)(vector_back(scope->entities));
+    return *vec_ptr_back(scope->entities);
 }
 
 void *scope_last_entity_from_scope_stop_at(struct scope *scope, struct scope *stop_scope)
@@ -105,7 +103,7 @@ void *scope_last_entity(struct compile_process *process)
 
 void scope_push(struct compile_process *process, void *ptr, size_t elem_size)
 {
-    vector_push(process->scope.current->entities, &ptr);
+    vec_ptr_push(process->scope.current->entities, ptr);
 
     process->scope.current->size += elem_size;
 }
@@ -24,6 +24,7 @@ void symresolver_end_table(struct compile_process *compiler)
     vector_pop(compiler->symbols.tables);
 }
 
+// name 必须是驻留字符串 (来自 token 或 node 的 sval), 这里只比较指针
 struct symbol *symresolver_get_symbol(struct compile_process *process, const char *name)
 {
     vector_set_peek_pointer(process->symbols.table, 0);
@@ -32,7 +33,7 @@ struct symbol *symresolver_get_symbol(struct compile_process *process, const cha
     while (symbol)
     {
 
-        if (S_EQ(symbol->name, name))
+        if (symbol->name == name)
         {
             break;
         }
@@ -43,8 +44,10 @@ struct symbol *symresolver_get_symbol(struct compile_process *process, const cha
     return symbol;
 }
 
+// 本地函数的名称通常是字面量, 先驻留才能与符号表中的指针比较
 struct symbol *symresolver_get_symbol_for_native_function(struct compile_process *process, const char *name)
 {
+    name = intern_cstr(process->strings, name);
     struct symbol *sym = symresolver_get_symbol(process, name);
     if (!sym)
         return NULL;
@@ -57,13 +60,15 @@ struct symbol *symresolver_get_symbol_for_native_function(struct compile_process
 
 struct symbol *symresolver_register_symbol(struct compile_process *process, const char *sym_name, int type, void *data)
 {
+    sym_name = intern_cstr(process->strings, sym_name);
+
     // Already registered then return NULL.
     if (symresolver_get_symbol(process, sym_name))
     {
         return NULL;
     }
 
-    struct symbol *sym = calloc(sizeof(struct symbol), 1);
+    struct symbol *sym = arena_calloc(process->arena, sizeof(struct symbol));
     sym->name = sym_name;
     sym->type = type;
     sym->data = data;
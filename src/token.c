@@ -1,12 +1,92 @@
 #include "token.h"
-
-#define PRIMITIVE_TYPES_TOTAL 7
-const char *primitive_types[PRIMITIVE_TYPES_TOTAL] = {
-    "void", "char", "short", "int", "long", "float", "double"};
+#include <assert.h>
+#include "../helpers/vector.h"
 
 bool token_is_keyword(token *token_instance, const char *keyword)
 {
-    return token_instance && token_instance->type == TOKEN_TYPE_KEYWORD && S_EQ(token_instance->sval, keyword);
+    return token_instance && token_instance->type == TOKEN_TYPE_KEYWORD && S_EQ(keyword_str(token_instance->keyword), keyword);
+}
+
+// 取出 token 的字符串值, 没有字符串值的 token 返回 NULL
+const char *token_sval(compile_process *process, struct token *token)
+{
+    switch (token->type)
+    {
+    case TOKEN_TYPE_IDENTIFIER:
+    case TOKEN_TYPE_STRING:
+    case TOKEN_TYPE_COMMENT:
+        return intern_str(process->strings, token->str_id);
+    case TOKEN_TYPE_KEYWORD:
+        return keyword_str(token->keyword);
+    case TOKEN_TYPE_OPERATOR:
+        return operator_str(token->op);
+    }
+    return NULL;
+}
+
+struct token_literal *token_literal(compile_process *process, struct token *token)
+{
+    assert(token->type == TOKEN_TYPE_NUMBER);
+    return vector_at(process->literals, token->literal_id);
+}
+
+// 记录每行的起始偏移
+static struct vector *token_line_starts(cfile *input)
+{
+    if (input->line_starts)
+    {
+        return input->line_starts;
+    }
+
+    struct vector *line_starts = vector_create(sizeof(uint32_t));
+    uint32_t offset = 0;
+    vector_push(line_starts, &offset);
+    lex_scan_line_starts(input->data, input->end - input->data, line_starts);
+    input->line_starts = line_starts;
+    return line_starts;
+}
+
+// 由源码偏移计算行列号, 行号二分查找行起始表得到; 只在报错等需要时调用
+pos source_position(cfile *file, size_t offset)
+{
+    struct vector *line_starts = token_line_starts(file);
+    const uint32_t *starts = vector_data_ptr(line_starts);
+    int low = 0;
+    int high = vector_count(line_starts) - 1;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if (starts[mid] <= offset)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return (pos){
+        .line = low + 1,
+        .col = offset - starts[low] + 1,
+        .filename = file->abs_path,
+    };
+}
+
+pos token_position(compile_process *process, struct token *token)
+{
+    return source_position(compile_process_file(process, token->file_id), token->offset);
+}
+
+bool token_is_keyword_id(struct token *token, int keyword)
+{
+    return token && token->type == TOKEN_TYPE_KEYWORD && token->keyword == keyword;
+}
+
+// 关键字编号; keyword 与标识符的驻留编号共用存储, 不是关键字的 token 返回 -1
+int token_keyword(struct token *token)
+{
+    return token && token->type == TOKEN_TYPE_KEYWORD ? token->keyword : -1;
 }
 
 bool token_is_symbol(struct token *token, char sym)
@@ -14,9 +94,9 @@ bool token_is_symbol(struct token *token, char sym)
     return token && token->type == TOKEN_TYPE_SYMBOL && token->cval == sym;
 }
 
-bool token_is_operator(struct token *token, const char *op)
+bool token_is_operator(struct token *token, int op)
 {
-    return token && token->type == TOKEN_TYPE_OPERATOR && S_EQ(token->sval, op);
+    return token && token->type == TOKEN_TYPE_OPERATOR && token->op == op;
 }
 
 bool token_is_primitive_keyword(struct token *token)
@@ -25,10 +105,52 @@ bool token_is_primitive_keyword(struct token *token)
         return false;
     if (token->type != TOKEN_TYPE_KEYWORD)
         return false;
-    for (int i = 0; i < PRIMITIVE_TYPES_TOTAL; i++)
+    switch (token->keyword)
     {
-        if (S_EQ(primitive_types[i], token->sval))
-            return true;
+    case KEYWORD_VOID:
+    case KEYWORD_CHAR:
+    case KEYWORD_SHORT:
+    case KEYWORD_INT:
+    case KEYWORD_LONG:
+    case KEYWORD_FLOAT:
+    case KEYWORD_DOUBLE:
+        return true;
     }
     return false;
-}
\ No newline at end of file
+}
+// 按需计算 token 所在最外层括号之间的源码, token 不在括号内时返回 NULL
+const char *token_between_brackets(compile_process *process, struct token *token)
+{
+    // 流式模式下没有完整的 token 向量可供回溯
+    if (!token || !(token->flags & TOKEN_FLAG_IN_EXPRESSION) || !process->token_vec)
+    {
+        return NULL;
+    }
+
+    struct token *tokens = vec_token_data(process->token_vec);
+    int count = vec_token_count(process->token_vec);
+    int index = token - tokens;
+    assert(index >= 0 && index < count);
+
+    // 向前找到最外层的 '(', 它本身不在括号内; 预处理后相邻的 token 可能来自不同的文件, 不跨越文件
+    uint16_t file_id = token->file_id;
+    int start = index;
+    while (start > 0 && (tokens[start].flags & TOKEN_FLAG_IN_EXPRESSION) && tokens[start - 1].file_id == file_id)
+    {
+        start--;
+    }
+    // 向后找到与之匹配的 ')', 文件提前结束时取到最后一个括号内的 token
+    int end = index;
+    while (end + 1 < count && (tokens[end + 1].flags & TOKEN_FLAG_IN_EXPRESSION) && tokens[end + 1].file_id == file_id)
+    {
+        end++;
+    }
+
+    // 在文件边界处停下时, 文本从边界上的 token 本身开始或结束
+    bool open_found = !(tokens[start].flags & TOKEN_FLAG_IN_EXPRESSION);
+    bool close_found = end + 1 < count && tokens[end + 1].file_id == file_id;
+    size_t begin_offset = open_found ? tokens[start].offset + tokens[start].length : tokens[start].offset;
+    size_t end_offset = close_found ? tokens[end + 1].offset : tokens[end].offset + tokens[end].length;
+    const char *data = compile_process_file(process, file_id)->data;
+    return intern_string(process->strings, data + begin_offset, end_offset - begin_offset);
+}
@@ -0,0 +1,201 @@
+#include "compiler.h"
+#include "../helpers/vector.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * token 缓存文件: 以源码内容的哈希命名, 依次存放文件头, token, 数字字面量,
+ * 驻留字符串表与字符串内容. 每个驻留字符串只存一次, 并记录驻留表的哈希值,
+ * 加载时整个文件 mmap 进来, 驻留表直接指向映射中的字符串, 不复制也不重新哈希.
+ */
+
+#define TOKEN_CACHE_MAGIC 0x544d4d43 // "CMMT"
+// token, 字面量或驻留哈希的格式改变时递增
+#define TOKEN_CACHE_VERSION 1
+#define TOKEN_CACHE_DEFAULT_DIR ".cmm-cache"
+
+struct token_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t content_hash;
+    uint64_t source_size;
+    uint32_t token_count;
+    uint32_t literal_count;
+    uint32_t string_count;
+    uint32_t string_bytes;
+};
+
+struct token_cache_string
+{
+    uint32_t offset;
+    uint32_t len;
+    uint32_t hash;
+};
+
+// 64 位内容哈希, 每次处理 8 个字节
+uint64_t token_cache_hash(const char *data, size_t len)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ len;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    uint64_t tail = 0;
+    if (len > i)
+    {
+        // 空文件的 data 为 NULL
+        memcpy(&tail, data + i, len - i);
+    }
+    hash = (hash ^ tail) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 29);
+}
+
+// 缓存目录可以由环境变量 CMM_TOKEN_CACHE 指定, 预编译头映像也放在这里
+const char *token_cache_dir()
+{
+    const char *dir = getenv("CMM_TOKEN_CACHE");
+    return dir && *dir ? dir : TOKEN_CACHE_DEFAULT_DIR;
+}
+
+static void token_cache_path(char *path, size_t size, uint64_t hash)
+{
+    snprintf(path, size, "%s/%016llx.tok", token_cache_dir(), (unsigned long long)hash);
+}
+
+static size_t token_cache_expected_size(const struct token_cache_header *header)
+{
+    return sizeof(*header) +
+           (size_t)header->token_count * sizeof(struct token) +
+           (size_t)header->literal_count * sizeof(struct token_literal) +
+           (size_t)header->string_count * sizeof(struct token_cache_string) +
+           header->string_bytes;
+}
+
+/**
+ * 查找输入文件的 token 缓存, 命中时把 token 放入 lexer->token_vec 并返回 true.
+ * 驻留表必须是空的, 这样字符串按顺序加入后编号与缓存中相同.
+ */
+bool token_cache_load(compile_process *process, lex_process *lexer, uint64_t hash)
+{
+    if (process->strings->count != 0 || vector_count(process->literals) != 0)
+    {
+        return false;
+    }
+
+    char path[PATH_MAX];
+    token_cache_path(path, sizeof(path), hash);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct token_cache_header))
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    const char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const struct token_cache_header *header = (const struct token_cache_header *)map;
+    size_t source_size = process->input_file->end - process->input_file->data;
+    if (header->magic != TOKEN_CACHE_MAGIC || header->version != TOKEN_CACHE_VERSION ||
+        header->content_hash != hash || header->source_size != source_size ||
+        token_cache_expected_size(header) != size)
+    {
+        munmap((void *)map, size);
+        return false;
+    }
+
+    const char *cur = map + sizeof(*header);
+    const struct token *tokens = (const struct token *)cur;
+    cur += header->token_count * sizeof(struct token);
+    const char *literals = cur;
+    cur += header->literal_count * sizeof(struct token_literal);
+    const struct token_cache_string *strings = (const struct token_cache_string *)cur;
+    const char *string_data = cur + header->string_count * sizeof(struct token_cache_string);
+
+    // 映射在整个编译期间保留, 驻留表中的字符串指向这里, compile_process_free 时解除
+    process->token_cache_map = map;
+    process->token_cache_map_size = size;
+    for (uint32_t i = 0; i < header->string_count; i++)
+    {
+        intern_string_id_static(process->strings, string_data + strings[i].offset, strings[i].len, strings[i].hash);
+    }
+    vector_push_n(process->literals, literals, header->literal_count);
+    vector_push_n(&lexer->token_vec->base, tokens, header->token_count);
+    process->input_file->cur = process->input_file->end;
+    return true;
+}
+
+/**
+ * 把词法分析的结果写入缓存. 先写入临时文件再改名, 并发的编译进程不会读到写了一半的缓存;
+ * 缓存只是加速手段, 写入失败时直接放弃.
+ */
+void token_cache_store(compile_process *process, VEC(token) *token_vec, uint64_t hash)
+{
+    char path[PATH_MAX];
+    token_cache_path(path, sizeof(path), hash);
+    mkdir(token_cache_dir(), 0755);
+
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file)
+    {
+        return;
+    }
+
+    struct intern_table *table = process->strings;
+    struct token_cache_header header = {
+        .magic = TOKEN_CACHE_MAGIC,
+        .version = TOKEN_CACHE_VERSION,
+        .content_hash = hash,
+        .source_size = process->input_file->end - process->input_file->data,
+        .token_count = vec_token_count(token_vec),
+        .literal_count = vector_count(process->literals),
+        .string_count = table->count,
+        .string_bytes = 0,
+    };
+    for (int i = 0; i < table->count; i++)
+    {
+        header.string_bytes += table->entries[i].len + 1;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(vector_data_ptr(&token_vec->base), sizeof(struct token), header.token_count, file);
+    fwrite(vector_data_ptr(process->literals), sizeof(struct token_literal), header.literal_count, file);
+    uint32_t offset = 0;
+    for (int i = 0; i < table->count; i++)
+    {
+        struct token_cache_string string = {.offset = offset, .len = table->entries[i].len, .hash = table->entries[i].hash};
+        fwrite(&string, sizeof(string), 1, file);
+        offset += string.len + 1;
+    }
+    for (int i = 0; i < table->count; i++)
+    {
+        // 带上结尾的 0, 加载后可以直接当作 C 字符串使用
+        fwrite(table->entries[i].str, 1, table->entries[i].len + 1, file);
+    }
+
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        unlink(tmp_path);
+    }
+}
@@ -0,0 +1,70 @@
+#include "compiler.h"
+#include "token.h"
+#include <assert.h>
+
+struct token_stream *token_stream_create(lex_process *lexer)
+{
+    struct token_stream *stream = calloc(1, sizeof(struct token_stream));
+    stream->lexer = lexer;
+    stream->line_start = true;
+    lex_begin(lexer);
+    return stream;
+}
+
+void token_stream_free(struct token_stream *stream)
+{
+    free(stream);
+}
+
+// 向词法分析器要一个 token 放入窗口, 读到文件尾返回 false
+static bool token_stream_fill(struct token_stream *stream)
+{
+    if (stream->eof)
+    {
+        return false;
+    }
+
+    struct token *token = lex_next_token(stream->lexer);
+    if (!token)
+    {
+        stream->eof = true;
+        return false;
+    }
+
+    // 没有经过预处理, 指令不能交给语法分析器
+    if (stream->line_start && token_is_symbol(token, '#'))
+    {
+        compile_process *compiler = stream->lexer->compiler;
+        compiler->file_id = token->file_id;
+        compiler->offset = token->offset;
+        compiler_error(compiler, "流式模式不做预处理, 不支持预处理指令\n");
+    }
+    stream->line_start = token->type == TOKEN_TYPE_NEWLINE || (stream->line_start && token->type == TOKEN_TYPE_COMMENT);
+
+    // 只覆盖已经交出去的 token, 预读的 token 不会被挤掉
+    assert(stream->tail - stream->head < TOKEN_STREAM_WINDOW);
+    struct token *slot = &stream->window[stream->tail & (TOKEN_STREAM_WINDOW - 1)];
+    *slot = *token;
+    stream->lexer->last_token = slot;
+    stream->tail++;
+    return true;
+}
+
+struct token *token_stream_peek(struct token_stream *stream)
+{
+    if (stream->head == stream->tail && !token_stream_fill(stream))
+    {
+        return NULL;
+    }
+    return &stream->window[stream->head & (TOKEN_STREAM_WINDOW - 1)];
+}
+
+struct token *token_stream_next(struct token_stream *stream)
+{
+    struct token *token = token_stream_peek(stream);
+    if (token)
+    {
+        stream->head++;
+    }
+    return token;
+}
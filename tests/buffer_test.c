@@ -0,0 +1,105 @@
+#include "compiler.h"
+#include <assert.h>
+#include <limits.h>
+
+// buffer 从内联存储移到堆或 arena 的边界, 以及格式化输出的重试
+
+// 检查 buffer 的内容与 expected 一致
+static void check_contents(struct buffer *buffer, const char *expected)
+{
+    assert(buffer->len == (int)strlen(expected));
+    assert(memcmp(buffer_ptr(buffer), expected, buffer->len) == 0);
+}
+
+// 由 c 重复 count 次组成的字符串
+static char *repeat(char c, int count)
+{
+    char *str = malloc(count + 1);
+    memset(str, c, count);
+    str[count] = '\0';
+    return str;
+}
+
+// 内联存储还要留一个字节给结尾的 0, 63 个字符恰好放得下, 64 个字符要扩容重试
+static void test_printf_inline_boundary()
+{
+    char *fits = repeat('a', BUFFER_INLINE_SIZE - 1);
+    struct buffer *buffer = buffer_create();
+    buffer_printf(buffer, "%s", fits);
+    assert(buffer_ptr(buffer) == buffer->inline_data);
+    check_contents(buffer, fits);
+    buffer_free(buffer);
+
+    char *overflows = repeat('b', BUFFER_INLINE_SIZE);
+    buffer = buffer_create();
+    buffer_printf(buffer, "%s", overflows);
+    assert(buffer_ptr(buffer) != buffer->inline_data);
+    check_contents(buffer, overflows);
+    buffer_free(buffer);
+    free(fits);
+    free(overflows);
+}
+
+// 重试时参数要从头再读一遍, 已有的内容在扩容时原样复制
+static void test_printf_retry_keeps_contents()
+{
+    char *prefix = repeat('p', BUFFER_INLINE_SIZE - 4);
+    struct buffer *buffer = buffer_create();
+    buffer_write_str(buffer, prefix);
+    buffer_printf(buffer, "%s-%d-%s", "abc", -12345, "xyz");
+
+    char expected[BUFFER_INLINE_SIZE * 2];
+    snprintf(expected, sizeof(expected), "%s%s-%d-%s", prefix, "abc", -12345, "xyz");
+    check_contents(buffer, expected);
+
+    // 扩容到恰好够用之后, 下一次格式化再次放不下也要完整写入
+    char *tail = repeat('t', BUFFER_INLINE_SIZE * 4);
+    buffer_printf(buffer, "%s", tail);
+    assert(buffer->len == (int)(strlen(expected) + strlen(tail)));
+    assert(memcmp((char *)buffer_ptr(buffer) + strlen(expected), tail, strlen(tail)) == 0);
+    buffer_free(buffer);
+    free(prefix);
+    free(tail);
+}
+
+static void test_arena_buffer()
+{
+    struct arena *arena = arena_create(ARENA_DEFAULT_CHUNK_SIZE);
+    struct buffer *buffer = buffer_create_arena(arena);
+    char *long_str = repeat('x', BUFFER_INLINE_SIZE * 3);
+    buffer_write_str(buffer, "head ");
+    buffer_printf(buffer, "%s", long_str);
+
+    char expected[BUFFER_INLINE_SIZE * 4];
+    snprintf(expected, sizeof(expected), "head %s", long_str);
+    check_contents(buffer, expected);
+    buffer_free(buffer);
+    arena_free(arena);
+    free(long_str);
+}
+
+static void test_integer_fast_paths()
+{
+    struct buffer *buffer = buffer_create();
+    buffer_write_int(buffer, 0);
+    buffer_write(buffer, ' ');
+    buffer_write_int(buffer, LLONG_MIN);
+    buffer_write(buffer, ' ');
+    buffer_write_uint(buffer, ULLONG_MAX);
+    buffer_write(buffer, ' ');
+    buffer_write_hex(buffer, 0);
+    buffer_write(buffer, ' ');
+    buffer_write_hex(buffer, 0xdeadbeef);
+    check_contents(buffer, "0 -9223372036854775808 18446744073709551615 0x0 0xdeadbeef");
+    buffer_free(buffer);
+}
+
+int main()
+{
+    test_printf_inline_boundary();
+    test_printf_retry_keeps_contents();
+    test_arena_buffer();
+    test_integer_fast_paths();
+    fprintf(stderr, "buffer_test: ok\n");
+    return 0;
+}
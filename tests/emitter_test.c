@@ -0,0 +1,143 @@
+#include "compiler.h"
+#include <assert.h>
+#include <unistd.h>
+
+// emit_* 函数在输出超过 EMIT_FLUSH_THRESHOLD 时写入 ofile, 写入的内容与顺序不变
+
+static char input_path[] = "/tmp/cmm_emitter_input_XXXXXX";
+static char output_path[] = "/tmp/cmm_emitter_output_XXXXXX";
+
+// 有输出文件时, 每次 emit_* 调用之后缓冲都不超过阈值
+static void check_threshold(compile_process *process)
+{
+    assert(!process->ofile || process->output->len < EMIT_FLUSH_THRESHOLD);
+}
+
+// 每个 emit_* 函数各写一次, 同样的内容也追加到 expected
+static void emit_each(compile_process *process, struct buffer *expected, int i)
+{
+    emit(process, "\tmov %s, %d\n", "eax", i);
+    check_threshold(process);
+    buffer_printf(expected, "\tmov %s, %d\n", "eax", i);
+    emit_str(process, "\tpush ");
+    check_threshold(process);
+    buffer_write_str(expected, "\tpush ");
+    emit_register(process, REGISTER_EBP);
+    check_threshold(process);
+    buffer_write_str(expected, "ebp");
+    emit_str(process, "\n\tjmp ");
+    check_threshold(process);
+    buffer_write_str(expected, "\n\tjmp ");
+    emit_label_name(process, ".L", i);
+    check_threshold(process);
+    buffer_printf(expected, ".L%d", i);
+    emit_str(process, "\n\tadd esp, ");
+    check_threshold(process);
+    buffer_write_str(expected, "\n\tadd esp, ");
+    emit_int(process, -i);
+    check_threshold(process);
+    buffer_printf(expected, "%d", -i);
+    emit_str(process, "\n");
+    check_threshold(process);
+    buffer_write_str(expected, "\n");
+    emit_label(process, ".L", i);
+    check_threshold(process);
+    buffer_printf(expected, ".L%d:\n", i);
+}
+
+static void test_flush_threshold()
+{
+    compile_process *process = compile_process_create(input_path, output_path, 0, 0);
+    assert(process);
+    struct buffer *expected = buffer_create();
+    bool flushed = false;
+    for (int i = 0; i < 10000; i++)
+    {
+        emit_each(process, expected, i);
+        flushed |= ftell(process->ofile) > 0;
+    }
+    assert(flushed);
+    emit_flush(process);
+    assert(process->output->len == 0);
+    compile_process_free(process);
+
+    FILE *file = fopen(output_path, "r");
+    struct vector *written = vector_create(sizeof(char));
+    vector_fread(written, 0, file);
+    fclose(file);
+    assert(vector_count(written) == expected->len);
+    assert(memcmp(vector_at(written, 0), buffer_ptr(expected), expected->len) == 0);
+    vector_free(written);
+    buffer_free(expected);
+}
+
+// 缓冲差一个字节到达阈值时, 任何一个 emit_* 函数写入之后都要写入文件
+static void test_each_function_flushes()
+{
+    compile_process *process = compile_process_create(input_path, output_path, 0, 0);
+    assert(process);
+    char *filler = malloc(EMIT_FLUSH_THRESHOLD);
+    memset(filler, ' ', EMIT_FLUSH_THRESHOLD - 1);
+    filler[EMIT_FLUSH_THRESHOLD - 1] = '\0';
+    for (int i = 0; i < 6; i++)
+    {
+        emit_str(process, filler);
+        assert(process->output->len == EMIT_FLUSH_THRESHOLD - 1);
+        switch (i)
+        {
+        case 0:
+            emit(process, "%d", 1);
+            break;
+        case 1:
+            emit_str(process, "x");
+            break;
+        case 2:
+            emit_int(process, 1);
+            break;
+        case 3:
+            emit_register(process, REGISTER_EAX);
+            break;
+        case 4:
+            emit_label_name(process, ".L", 1);
+            break;
+        case 5:
+            emit_label(process, ".L", 1);
+            break;
+        }
+        assert(process->output->len < EMIT_FLUSH_THRESHOLD);
+    }
+    free(filler);
+    compile_process_free(process);
+}
+
+// 没有输出文件时全部留在缓冲中
+static void test_no_output_file()
+{
+    compile_process *process = compile_process_create(input_path, NULL, 0, 0);
+    assert(process);
+    struct buffer *expected = buffer_create();
+    for (int i = 0; i < 10000; i++)
+    {
+        emit_each(process, expected, i);
+    }
+    assert(expected->len >= EMIT_FLUSH_THRESHOLD);
+    assert(process->output->len == expected->len);
+    assert(memcmp(buffer_ptr(process->output), buffer_ptr(expected), expected->len) == 0);
+    buffer_free(expected);
+    compile_process_free(process);
+}
+
+int main()
+{
+    close(mkstemp(input_path));
+    close(mkstemp(output_path));
+
+    test_flush_threshold();
+    test_each_function_flushes();
+    test_no_output_file();
+
+    unlink(input_path);
+    unlink(output_path);
+    fprintf(stderr, "emitter_test: ok\n");
+    return 0;
+}
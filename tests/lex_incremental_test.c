@@ -0,0 +1,88 @@
+#include "compiler.h"
+#include <assert.h>
+#include <unistd.h>
+
+// 增量分析的结果必须与对编辑后的源码完整地重新分析一致
+
+static compile_process *lex_file(const char *path, const char *source, lex_process **lexer)
+{
+    FILE *file = fopen(path, "w");
+    assert(file);
+    fputs(source, file);
+    fclose(file);
+
+    compile_process *process = compile_process_create(path, NULL, 0, 0);
+    assert(process);
+    *lexer = lex_process_create(process, &compiler_lex_functions, NULL);
+    assert(lex(*lexer) == LEXICAL_ANALYSIS_ALL_OK);
+    return process;
+}
+
+static void check_edit(const char *source, size_t start, size_t end, const char *text)
+{
+    char path[] = "/tmp/cmm_lex_incremental_XXXXXX";
+    close(mkstemp(path));
+
+    lex_process *lexer = NULL;
+    compile_process *process = lex_file(path, source, &lexer);
+    assert(lex_incremental(lexer, start, end, text, strlen(text)) == LEXICAL_ANALYSIS_ALL_OK);
+
+    // 把编辑后的源码写回文件, 完整地重新分析
+    cfile *input = process->input_file;
+    char *edited = strndup(input->data, input->end - input->data);
+    lex_process *full = NULL;
+    compile_process *full_process = lex_file(path, edited, &full);
+    unlink(path);
+
+    assert(vec_token_count(lexer->token_vec) == vec_token_count(full->token_vec));
+    for (int i = 0; i < vec_token_count(full->token_vec); i++)
+    {
+        struct token *a = vec_token_at(lexer->token_vec, i);
+        struct token *b = vec_token_at(full->token_vec, i);
+        assert(a->type == b->type);
+        assert(a->offset == b->offset && a->length == b->length);
+        assert(a->flags == b->flags);
+    }
+    free(edited);
+    lex_process_free(lexer);
+    compile_process_free(process);
+    lex_process_free(full);
+    compile_process_free(full_process);
+}
+
+// #include <...> 中的编辑: 重新分析时要知道前一个 token 是 include
+static void test_edit_inside_include_path()
+{
+    const char *source = "#include <abc.h>\nint x;\n";
+    check_edit(source, 12, 12, "");
+    check_edit(source, 11, 12, "xy");
+    check_edit(source, 10, 16, "<d.h>");
+
+    lex_process *lexer = NULL;
+    char path[] = "/tmp/cmm_lex_incremental_XXXXXX";
+    close(mkstemp(path));
+    compile_process *process = lex_file(path, source, &lexer);
+    unlink(path);
+    assert(lex_incremental(lexer, 12, 12, "", 0) == LEXICAL_ANALYSIS_ALL_OK);
+    struct token *name = vec_token_at(lexer->token_vec, 2);
+    assert(name->type == TOKEN_TYPE_STRING && name->length == strlen("<abc.h>"));
+    lex_process_free(lexer);
+    compile_process_free(process);
+}
+
+// 把 include 改坏之后, 后面的 <abc.h> 不能再与旧的字符串 token 同步
+static void test_edit_include_keyword()
+{
+    check_edit("#include <abc.h>\nint x;\n", 1, 8, "inclde");
+    check_edit("#inclde <abc.h>\nint x;\n", 1, 7, "include");
+}
+
+int main()
+{
+    // 词法分析器会打印 token
+    freopen("/dev/null", "w", stdout);
+    test_edit_inside_include_path();
+    test_edit_include_keyword();
+    fprintf(stderr, "lex_incremental_test: ok\n");
+    return 0;
+}
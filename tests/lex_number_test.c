@@ -0,0 +1,140 @@
+#include "compiler.h"
+#include <assert.h>
+
+// 数字字面量的解析: 整数的进制前缀与后缀, 溢出, 以及浮点数与 strtod/strtof 逐位一致
+
+static void check_integer(const char *str, unsigned long long value, int type, bool is_unsigned, size_t length)
+{
+    struct token_literal literal;
+    const char *error = NULL;
+    size_t parsed = lex_number_parse(str, strlen(str), &literal, &error);
+    if (parsed != length || literal.llnum != value || literal.type != type || literal.is_unsigned != is_unsigned)
+    {
+        fprintf(stderr, "%s: length %zu value %llu type %d unsigned %d\n", str, parsed, literal.llnum, literal.type, literal.is_unsigned);
+    }
+    assert(!error);
+    assert(parsed == length);
+    assert(literal.llnum == value);
+    assert(literal.type == type);
+    assert(literal.is_unsigned == is_unsigned);
+}
+
+static void check_error(const char *str)
+{
+    struct token_literal literal;
+    const char *error = NULL;
+    assert(lex_number_parse(str, strlen(str), &literal, &error) == 0);
+    assert(error);
+}
+
+// 不带后缀的部分交给 strtod 或 strtof, 结果必须逐位相同
+static void check_float(const char *str, int type)
+{
+    struct token_literal literal;
+    const char *error = NULL;
+    size_t len = strlen(str);
+    assert(lex_number_parse(str, len, &literal, &error) == len);
+    assert(!error);
+    assert(literal.type == type);
+
+    // 十六进制浮点数以指数结尾, 最后的 f 也只能是后缀
+    char *digits = strdup(str);
+    char last = digits[len - 1];
+    if (last == 'f' || last == 'F' || last == 'l' || last == 'L')
+    {
+        digits[len - 1] = '\0';
+    }
+    double expected = type == NUMBER_TYPE_FLOAT ? strtof(digits, NULL) : strtod(digits, NULL);
+    if (memcmp(&literal.dval, &expected, sizeof(double)) != 0)
+    {
+        fprintf(stderr, "%s: got %a expected %a\n", str, literal.dval, expected);
+    }
+    assert(memcmp(&literal.dval, &expected, sizeof(double)) == 0);
+    free(digits);
+}
+
+static void test_integer_prefixes_and_suffixes()
+{
+    check_integer("0", 0, NUMBER_TYPE_NORMAL, false, 1);
+    check_integer("42;", 42, NUMBER_TYPE_NORMAL, false, 2);
+    // 8 位一组的 SWAR 路径与逐位的尾部
+    check_integer("1234567890123", 1234567890123ull, NUMBER_TYPE_NORMAL, false, 13);
+    check_integer("0x1F", 0x1F, NUMBER_TYPE_NORMAL, false, 4);
+    check_integer("0XabcDEF", 0xabcdef, NUMBER_TYPE_NORMAL, false, 8);
+    check_integer("017", 017, NUMBER_TYPE_NORMAL, false, 3);
+    check_integer("0b101", 5, NUMBER_TYPE_NORMAL, false, 5);
+
+    check_integer("10u", 10, NUMBER_TYPE_NORMAL, true, 3);
+    check_integer("10L", 10, NUMBER_TYPE_LONG, false, 3);
+    check_integer("10UL", 10, NUMBER_TYPE_LONG, true, 4);
+    check_integer("10lu", 10, NUMBER_TYPE_LONG, true, 4);
+    check_integer("10ll", 10, NUMBER_TYPE_LONG_LONG, false, 4);
+    check_integer("0x10LLU", 16, NUMBER_TYPE_LONG_LONG, true, 7);
+    check_integer("0b1uLL", 1, NUMBER_TYPE_LONG_LONG, true, 6);
+    // LL 的大小写必须一致, 重复的后缀不属于这个数字
+    check_integer("10Ll", 10, NUMBER_TYPE_LONG, false, 3);
+    check_integer("10uu", 10, NUMBER_TYPE_NORMAL, true, 3);
+
+    check_error("0x");
+    check_error("0b");
+    check_error("0b12");
+    check_error("09");
+}
+
+static void test_integer_overflow()
+{
+    check_integer("18446744073709551615", 18446744073709551615ull, NUMBER_TYPE_NORMAL, false, 20);
+    check_integer("0xFFFFFFFFFFFFFFFF", 0xFFFFFFFFFFFFFFFFull, NUMBER_TYPE_NORMAL, false, 18);
+    check_integer("01777777777777777777777", 0xFFFFFFFFFFFFFFFFull, NUMBER_TYPE_NORMAL, false, 23);
+    check_error("18446744073709551616");
+    check_error("99999999999999999999999999");
+    check_error("0x10000000000000000");
+    check_error("02000000000000000000000");
+    check_error("0b11111111111111111111111111111111111111111111111111111111111111111");
+}
+
+static void test_decimal_floats()
+{
+    const char *doubles[] = {
+        "1.5", "0.1", "3.14159", "1e10", "1e-10", "1.", ".5", "123.456e-7", "1.7976931348623157e308",
+        // 正好位于两个 double 中间, 向偶数舍入
+        "9007199254740993.0", "9007199254740995.0", "1.00000000000000011102230246251565404236316680908203125",
+        // 超过 19 位的有效数字被截断, 两端舍入不一致时交给 strtod
+        "9007199254740993.00000000000000000001", "123456789012345678901234567890.0",
+        "0.30000000000000000000000000000000000000001",
+        // 非规格化数, 下溢与上溢
+        "4.9e-324", "2.4703282292062328e-324", "2.2250738585072011e-308", "1e-400", "1e400",
+        "1.5l",
+    };
+    for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+    {
+        check_float(doubles[i], NUMBER_TYPE_DOUBLE);
+    }
+
+    const char *floats[] = {"1.5f", "0.1f", "3.4028235e38f", "1e39f", "1.4e-45f", "1.17549435e-38F", "16777217.0f"};
+    for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++)
+    {
+        check_float(floats[i], NUMBER_TYPE_FLOAT);
+    }
+}
+
+static void test_hex_floats()
+{
+    const char *doubles[] = {"0x1p0", "0x1.8p1", "0x.8p0", "0xA.Bp-3", "0x1.fffffffffffffp1023", "0x1p-1074", "0x1p-1075", "0x1.00000000000008p0", "0x1p2000"};
+    for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+    {
+        check_float(doubles[i], NUMBER_TYPE_DOUBLE);
+    }
+    check_float("0x1p-1f", NUMBER_TYPE_FLOAT);
+    check_float("0x1.000001p0f", NUMBER_TYPE_FLOAT);
+}
+
+int main()
+{
+    test_integer_prefixes_and_suffixes();
+    test_integer_overflow();
+    test_decimal_floats();
+    test_hex_floats();
+    fprintf(stderr, "lex_number_test: ok\n");
+    return 0;
+}
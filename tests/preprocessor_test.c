@@ -0,0 +1,249 @@
+// nftw 的 FTW_DEPTH
+#define _GNU_SOURCE
+#include "compiler.h"
+#include <assert.h>
+#include <ftw.h>
+#include <limits.h>
+#include <unistd.h>
+
+// 预处理的结果以 token 的源码拼写用空格连接, 与期望的文本比较
+
+// 测试文件与缓存都放在这个目录中, 结束时整个删除
+static char dir[] = "/tmp/cmm_preprocessor_XXXXXX";
+
+static void test_path(char *path, const char *name)
+{
+    snprintf(path, PATH_MAX, "%s/%s", dir, name);
+}
+
+static void write_file(const char *name, const char *source)
+{
+    char path[PATH_MAX];
+    test_path(path, name);
+    FILE *file = fopen(path, "w");
+    assert(file);
+    fputs(source, file);
+    fclose(file);
+}
+
+// 换行与注释不输出
+static char *render(compile_process *process, VEC(token) *tokens)
+{
+    struct buffer *out = buffer_create();
+    for (int i = 0; i < vec_token_count(tokens); i++)
+    {
+        struct token *token = vec_token_at(tokens, i);
+        if (token->type == TOKEN_TYPE_NEWLINE || token->type == TOKEN_TYPE_COMMENT)
+        {
+            continue;
+        }
+        if (out->len > 0)
+        {
+            buffer_write(out, ' ');
+        }
+        buffer_write_bytes(out, compile_process_file(process, token->file_id)->data + token->offset, token->length);
+    }
+    buffer_write(out, 0);
+    char *text = strdup(buffer_ptr(out));
+    buffer_free(out);
+    return text;
+}
+
+static void check_text(const char *text, const char *expected)
+{
+    if (!S_EQ(text, expected))
+    {
+        fprintf(stderr, "expected: %s\n     got: %s\n", expected, text);
+    }
+    assert(S_EQ(text, expected));
+}
+
+// 第一次分析写入 token 缓存, 第二次从缓存读出, token 与驻留的字符串都要相同
+static void check_token_cache(const char *source)
+{
+    write_file("cached.cmm", source);
+    char path[PATH_MAX];
+    test_path(path, "cached.cmm");
+    compile_process *processes[2];
+    lex_process *lexers[2];
+    for (int i = 0; i < 2; i++)
+    {
+        processes[i] = compile_process_create(path, NULL, 0, COMPILE_PROCESS_FLAG_TOKEN_CACHE);
+        assert(processes[i]);
+        lexers[i] = lex_process_create(processes[i], &compiler_lex_functions, NULL);
+        cfile *input = processes[i]->input_file;
+        uint64_t hash = token_cache_hash(input->data, input->end - input->data);
+        bool hit = token_cache_load(processes[i], lexers[i], hash);
+        assert(hit == (i == 1));
+        if (!hit)
+        {
+            assert(lex(lexers[i]) == LEXICAL_ANALYSIS_ALL_OK);
+            token_cache_store(processes[i], lexers[i]->token_vec, hash);
+        }
+    }
+
+    VEC(token) *lexed = lexers[0]->token_vec;
+    VEC(token) *cached = lexers[1]->token_vec;
+    assert(vec_token_count(lexed) == vec_token_count(cached));
+    for (int i = 0; i < vec_token_count(lexed); i++)
+    {
+        struct token *a = vec_token_at(lexed, i);
+        struct token *b = vec_token_at(cached, i);
+        assert(memcmp(a, b, sizeof(struct token)) == 0);
+        const char *a_sval = token_sval(processes[0], a);
+        const char *b_sval = token_sval(processes[1], b);
+        assert(a_sval ? b_sval && S_EQ(a_sval, b_sval) : !b_sval);
+        if (a->type == TOKEN_TYPE_NUMBER)
+        {
+            assert(memcmp(token_literal(processes[0], a), token_literal(processes[1], b), sizeof(struct token_literal)) == 0);
+        }
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        lex_process_free(lexers[i]);
+        compile_process_free(processes[i]);
+    }
+}
+
+// 预处理 main.cmm, 其中包含的头文件要事先写好
+static void check_preprocess(const char *source, const char *expected)
+{
+    write_file("main.cmm", source);
+    char path[PATH_MAX];
+    test_path(path, "main.cmm");
+    compile_process *process = compile_process_create(path, NULL, 0, 0);
+    assert(process);
+    lex_process *lexer = lex_process_create(process, &compiler_lex_functions, NULL);
+    assert(lex(lexer) == LEXICAL_ANALYSIS_ALL_OK);
+    process->token_vec = lexer->token_vec;
+    assert(preprocess(process) == PREPROCESS_ALL_OK);
+
+    char *text = render(process, process->token_vec);
+    check_text(text, expected);
+    free(text);
+    lex_process_free(lexer);
+    compile_process_free(process);
+}
+
+static void test_include()
+{
+    write_file("plain.h", "int plain;\n");
+    check_preprocess("#include \"plain.h\"\n#include \"plain.h\"\nint x;\n", "int plain ; int plain ; int x ;");
+
+    write_file("once.h", "#pragma once\nint once;\n");
+    check_preprocess("#include \"once.h\"\n#include \"once.h\"\n", "int once ;");
+}
+
+// include guard 只在宏已经定义时跳过头文件, 与 #ifndef 的语义一致
+static void test_include_guard()
+{
+    write_file("guard.h", "#ifndef GUARD_H\n#define GUARD_H\n#define G 1\nint g = G;\n#endif\n");
+    check_preprocess("#include \"guard.h\"\n#include \"guard.h\"\nint x = G;\n", "int g = 1 ; int x = 1 ;");
+    check_preprocess("#define GUARD_H\n#include \"guard.h\"\nint x = G;\n", "int x = G ;");
+    check_preprocess("#include \"guard.h\"\n#undef GUARD_H\n#include \"guard.h\"\n", "int g = 1 ; int g = 1 ;");
+}
+
+static void test_object_and_function_macros()
+{
+    check_preprocess("#define N 10\n#define G (N)\nint x = N + G;\n#undef N\nint y = N;\n", "int x = 10 + ( 10 ) ; int y = N ;");
+    check_preprocess("#define MAX(a, b) a > b ? a : b\nint y = MAX(MAX(1, 2), 3);\nint z = MAX;\n",
+                     "int y = 1 > 2 ? 1 : 2 > 3 ? 1 > 2 ? 1 : 2 : 3 ; int z = MAX ;");
+    check_preprocess("#define V(fmt, ...) printf(fmt, __VA_ARGS__)\nV(\"a\", 1, (2, 3));\n", "printf ( \"a\" , 1 , ( 2 , 3 ) ) ;");
+}
+
+static void test_stringize_and_paste()
+{
+    check_preprocess("#define STR(x) #x\nchar *s = STR(hello   world + 1);\n", "char * s = \"hello world + 1\" ;");
+    check_preprocess("#define CAT(a, b) a ## b\nint CAT(foo, bar) = CAT(1, 2);\n", "int foobar = 12 ;");
+}
+
+// 宏名在自己的展开结果中不再展开
+static void test_recursive_macros()
+{
+    check_preprocess("#define A B\n#define B A\nint a = A;\nint b = B;\n", "int a = A ; int b = B ;");
+    check_preprocess("#define f f + 1\nint z = f;\n", "int z = f + 1 ;");
+}
+
+// 展开为空的宏之后, 同一行的 '#' 不是指令
+static void test_directive_after_empty_expansion()
+{
+    check_preprocess("#define E\nE #define X 1\nX\n", "# define X 1 X");
+    check_preprocess("#define E\nE\n#define X 1\nX\n", "1");
+}
+
+static void test_token_cache()
+{
+    check_token_cache("int main()\n{\n    char *s = \"str\";\n    return 0x10 + 1.5 + sizeof(s); // comment\n}\n");
+    check_token_cache("");
+}
+
+// 与 compile_file 相同: 先处理前置头文件, 输入文件预处理的结果接在它之后
+static char *preprocess_with_prelude(const char *prelude_name, bool *from_image)
+{
+    char path[PATH_MAX];
+    char prelude[PATH_MAX];
+    test_path(path, "main.cmm");
+    test_path(prelude, prelude_name);
+    compile_process *process = compile_process_create(path, NULL, 0, COMPILE_PROCESS_FLAG_PRELUDE);
+    assert(process);
+    VEC(token) *tokens = pch_load(process, prelude);
+    assert(tokens);
+    *from_image = process->pch_map != NULL;
+
+    lex_process *lexer = lex_process_create(process, &compiler_lex_functions, NULL);
+    assert(lex(lexer) == LEXICAL_ANALYSIS_ALL_OK);
+    process->token_vec = lexer->token_vec;
+    assert(preprocess(process) == PREPROCESS_ALL_OK);
+    vector_push_n(&tokens->base, vec_token_data(process->token_vec), vec_token_count(process->token_vec));
+
+    char *text = render(process, tokens);
+    vector_free(&tokens->base);
+    lex_process_free(lexer);
+    compile_process_free(process);
+    return text;
+}
+
+// 第一次从源码处理前置头文件并写入映像, 第二次从映像读出, 结果要相同
+static void test_pch()
+{
+    write_file("prelude.h", "#pragma once\n#define TWICE(x) ((x) * 2)\n#include \"guard.h\"\nint prelude;\n");
+    write_file("main.cmm", "#include \"prelude.h\"\n#include \"guard.h\"\nint y = TWICE(G);\n");
+
+    bool from_image = true;
+    char *built = preprocess_with_prelude("prelude.h", &from_image);
+    assert(!from_image);
+    check_text(built, "int g = 1 ; int prelude ; int y = ( ( 1 ) * 2 ) ;");
+    char *mapped = preprocess_with_prelude("prelude.h", &from_image);
+    assert(from_image);
+    check_text(mapped, built);
+    free(built);
+    free(mapped);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+int main()
+{
+    // 词法分析器会打印 token
+    freopen("/dev/null", "w", stdout);
+    assert(mkdtemp(dir));
+    char cache_dir[PATH_MAX];
+    test_path(cache_dir, "cache");
+    setenv("CMM_TOKEN_CACHE", cache_dir, 1);
+
+    test_include();
+    test_include_guard();
+    test_object_and_function_macros();
+    test_stringize_and_paste();
+    test_recursive_macros();
+    test_directive_after_empty_expansion();
+    test_token_cache();
+    test_pch();
+
+    nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    fprintf(stderr, "preprocessor_test: ok\n");
+    return 0;
+}
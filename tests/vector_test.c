@@ -0,0 +1,137 @@
+#include "compiler.h"
+#include <assert.h>
+#include <unistd.h>
+
+// vector 批量操作的边界情况
+
+static struct vector *int_vector(int count)
+{
+    struct vector *vector = vector_create(sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        vector_push(vector, &i);
+    }
+    return vector;
+}
+
+// 检查 vector 的内容与 expected 一致
+static void check_ints(struct vector *vector, const int *expected, int count)
+{
+    assert(vector_count(vector) == count);
+    for (int i = 0; i < count; i++)
+    {
+        assert(*(int *)vector_at(vector, i) == expected[i]);
+    }
+}
+
+static void test_splice_at_ends()
+{
+    int insert[] = {10, 11};
+
+    struct vector *vector = int_vector(3);
+    vector_splice(vector, 0, 0, insert, 2);
+    check_ints(vector, (int[]){10, 11, 0, 1, 2}, 5);
+    vector_splice(vector, vector_count(vector), 0, insert, 2);
+    check_ints(vector, (int[]){10, 11, 0, 1, 2, 10, 11}, 7);
+
+    // 在末尾替换与删除
+    vector_splice(vector, 5, 2, insert, 1);
+    check_ints(vector, (int[]){10, 11, 0, 1, 2, 10}, 6);
+    vector_splice(vector, 0, 2, NULL, 0);
+    check_ints(vector, (int[]){0, 1, 2, 10}, 4);
+    vector_free(vector);
+}
+
+static void test_erase()
+{
+    struct vector *vector = int_vector(5);
+    vector_erase(vector, 2, 0);
+    vector_erase(vector, 0, 0);
+    vector_erase(vector, 5, 0);
+    check_ints(vector, (int[]){0, 1, 2, 3, 4}, 5);
+
+    vector_erase(vector, 1, 2);
+    check_ints(vector, (int[]){0, 3, 4}, 3);
+    vector_erase(vector, 0, 3);
+    assert(vector_empty(vector));
+    vector_free(vector);
+}
+
+// 插入的元素超出容量时, 尾部要在扩容之后移动
+static void test_splice_grows()
+{
+    int insert[VECTOR_ELEMENT_INCREMENT * 3];
+    for (int i = 0; i < VECTOR_ELEMENT_INCREMENT * 3; i++)
+    {
+        insert[i] = 100 + i;
+    }
+
+    struct vector *vector = int_vector(VECTOR_ELEMENT_INCREMENT - 2);
+    vector_splice(vector, 5, 1, insert, VECTOR_ELEMENT_INCREMENT * 3);
+    assert(vector_count(vector) == VECTOR_ELEMENT_INCREMENT * 4 - 3);
+    for (int i = 0; i < vector_count(vector); i++)
+    {
+        int expected = i < 5 ? i : i < 5 + VECTOR_ELEMENT_INCREMENT * 3 ? 100 + i - 5 : i - VECTOR_ELEMENT_INCREMENT * 3 + 1;
+        assert(*(int *)vector_at(vector, i) == expected);
+    }
+    vector_free(vector);
+}
+
+static void test_push_n_and_swap_remove()
+{
+    int elems[] = {7, 8, 9};
+    struct vector *vector = int_vector(2);
+    vector_push_n(vector, elems, 0);
+    vector_push_n(vector, elems, 3);
+    check_ints(vector, (int[]){0, 1, 7, 8, 9}, 5);
+
+    vector_swap_remove(vector, 1);
+    check_ints(vector, (int[]){0, 9, 7, 8}, 4);
+    vector_swap_remove(vector, 3);
+    check_ints(vector, (int[]){0, 9, 7}, 3);
+    vector_free(vector);
+}
+
+// 文件比请求的短时, fread 返回实际读到的数量
+static void test_short_fread()
+{
+    char path[] = "/tmp/cmm_vector_XXXXXX";
+    close(mkstemp(path));
+    int total = VECTOR_ELEMENT_INCREMENT * 2 + 5;
+    FILE *file = fopen(path, "w");
+    for (int i = 0; i < total; i++)
+    {
+        fwrite(&i, sizeof(int), 1, file);
+    }
+    fclose(file);
+
+    struct vector *vector = int_vector(1);
+    file = fopen(path, "r");
+    assert(vector_fread(vector, total * 2, file) == total);
+    fclose(file);
+    assert(vector_count(vector) == total + 1);
+    for (int i = 0; i < total; i++)
+    {
+        assert(*(int *)vector_at(vector, i + 1) == i);
+    }
+
+    // amount <= 0 时读到文件结束
+    vector_clear(vector);
+    file = fopen(path, "r");
+    assert(vector_fread(vector, 0, file) == total);
+    fclose(file);
+    assert(vector_count(vector) == total);
+    unlink(path);
+    vector_free(vector);
+}
+
+int main()
+{
+    test_splice_at_ends();
+    test_erase();
+    test_splice_grows();
+    test_push_n_and_swap_remove();
+    test_short_fread();
+    fprintf(stderr, "vector_test: ok\n");
+    return 0;
+}
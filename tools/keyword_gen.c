@@ -0,0 +1,73 @@
+// 构建时生成关键字完美哈希表: keyword_gen > keyword_table.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "../src/keyword_hash.h"
+
+struct keyword_def
+{
+    const char *enum_name;
+    const char *name;
+};
+
+static const struct keyword_def keywords[] = {
+#define KEYWORD(name, str) {"KEYWORD_" #name, str},
+#include "../src/keywords.def"
+#undef KEYWORD
+};
+
+#define TOTAL_KEYWORDS (sizeof(keywords) / sizeof(keywords[0]))
+
+static bool seed_is_perfect(uint32_t seed, int *slots)
+{
+    bool used[KEYWORD_TABLE_SIZE] = {false};
+    for (size_t i = 0; i < TOTAL_KEYWORDS; i++)
+    {
+        const char *name = keywords[i].name;
+        int slot = keyword_hash(name, strlen(name), seed) & (KEYWORD_TABLE_SIZE - 1);
+        if (used[slot])
+        {
+            return false;
+        }
+        used[slot] = true;
+        slots[i] = slot;
+    }
+    return true;
+}
+
+int main()
+{
+    int slots[TOTAL_KEYWORDS];
+    uint32_t seed = 0;
+    while (!seed_is_perfect(seed, slots))
+    {
+        seed++;
+        if (seed == 0)
+        {
+            fprintf(stderr, "keyword_gen: no perfect hash seed for %d slots\n", KEYWORD_TABLE_SIZE);
+            return 1;
+        }
+    }
+
+    size_t min_len = (size_t)-1;
+    size_t max_len = 0;
+    for (size_t i = 0; i < TOTAL_KEYWORDS; i++)
+    {
+        size_t len = strlen(keywords[i].name);
+        min_len = len < min_len ? len : min_len;
+        max_len = len > max_len ? len : max_len;
+    }
+
+    printf("// 由 tools/keyword_gen.c 生成, 请勿手动修改\n");
+    printf("#define KEYWORD_HASH_SEED %uu\n", seed);
+    printf("#define KEYWORD_MIN_LEN %zu\n", min_len);
+    printf("#define KEYWORD_MAX_LEN %zu\n\n", max_len);
+    printf("static const struct keyword_entry keyword_table[KEYWORD_TABLE_SIZE] = {\n");
+    for (size_t i = 0; i < TOTAL_KEYWORDS; i++)
+    {
+        printf("    [%d] = {\"%s\", %zu, %s},\n", slots[i], keywords[i].name, strlen(keywords[i].name), keywords[i].enum_name);
+    }
+    printf("};\n");
+    return 0;
+}
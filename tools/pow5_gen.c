@@ -0,0 +1,129 @@
+// 构建时生成浮点数解析用的 5 的幂表: pow5_gen > pow5_table.h
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// 10^q 在 double 范围内有意义的 q
+#define POW5_MIN_EXPONENT -342
+#define POW5_MAX_EXPONENT 308
+
+// 足够放下 2^(2 * 795 + 128) 的大整数, 低位在前
+#define BIG_LIMBS 64
+
+struct big
+{
+    uint32_t limbs[BIG_LIMBS];
+};
+
+static void big_set(struct big *x, uint32_t value)
+{
+    memset(x, 0, sizeof(*x));
+    x->limbs[0] = value;
+}
+
+static void big_mul_small(struct big *x, uint32_t m)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < BIG_LIMBS; i++)
+    {
+        uint64_t t = (uint64_t)x->limbs[i] * m + carry;
+        x->limbs[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+}
+
+static void big_div_small(struct big *x, uint32_t d)
+{
+    uint64_t rem = 0;
+    for (int i = BIG_LIMBS - 1; i >= 0; i--)
+    {
+        uint64_t t = (rem << 32) | x->limbs[i];
+        x->limbs[i] = (uint32_t)(t / d);
+        rem = t % d;
+    }
+}
+
+static void big_add_one(struct big *x)
+{
+    for (int i = 0; i < BIG_LIMBS && ++x->limbs[i] == 0; i++)
+    {
+    }
+}
+
+static int big_bit_length(const struct big *x)
+{
+    for (int i = BIG_LIMBS - 1; i >= 0; i--)
+    {
+        if (x->limbs[i])
+        {
+            return i * 32 + 32 - __builtin_clz(x->limbs[i]);
+        }
+    }
+    return 0;
+}
+
+static int big_bit(const struct big *x, int bit)
+{
+    return bit >= 0 && (x->limbs[bit / 32] >> (bit % 32)) & 1;
+}
+
+// 取最高的 128 位 (截断), 不足 128 位时左移补齐
+static void big_top_128(const struct big *x, uint64_t *hi, uint64_t *lo)
+{
+    int top = big_bit_length(x) - 1;
+    *hi = 0;
+    *lo = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        *hi = (*hi << 1) | big_bit(x, top - i);
+        *lo = (*lo << 1) | big_bit(x, top - 64 - i);
+    }
+}
+
+static void big_pow5(struct big *x, int k)
+{
+    big_set(x, 1);
+    for (int i = 0; i < k; i++)
+    {
+        big_mul_small(x, 5);
+    }
+}
+
+int main()
+{
+    printf("// 由 tools/pow5_gen.c 生成, 请勿手动修改\n");
+    printf("#define POW5_MIN_EXPONENT %d\n", POW5_MIN_EXPONENT);
+    printf("#define POW5_MAX_EXPONENT %d\n\n", POW5_MAX_EXPONENT);
+    printf("// 5^q 规格化到 [2^127, 2^128) 的 128 位近似值 {高 64 位, 低 64 位}\n");
+    printf("static const uint64_t pow5_table[][2] = {\n");
+    for (int q = POW5_MIN_EXPONENT; q <= POW5_MAX_EXPONENT; q++)
+    {
+        struct big x;
+        if (q < 0)
+        {
+            // 负幂取 2^b / 5^-q 向上取整, b 保证商至少有 128 位
+            struct big power5;
+            big_pow5(&power5, -q);
+            int z = big_bit_length(&power5);
+            int b = q >= -27 ? z + 127 : 2 * z + 128;
+            big_set(&x, 0);
+            x.limbs[b / 32] = 1u << (b % 32);
+            for (int i = 0; i < -q; i++)
+            {
+                big_div_small(&x, 5);
+            }
+            big_add_one(&x);
+        }
+        else
+        {
+            big_pow5(&x, q);
+        }
+
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+        big_top_128(&x, &hi, &lo);
+        printf("    {0x%016llxull, 0x%016llxull},\n", (unsigned long long)hi, (unsigned long long)lo);
+    }
+    printf("};\n");
+    return 0;
+}